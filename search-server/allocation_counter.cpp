@@ -0,0 +1,53 @@
+#include "allocation_counter.h"
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+namespace {
+/**
+ * Выделения памяти в текущем потоке
+ */
+thread_local size_t allocation_count = 0;
+}
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+/**
+ * Выделить память и учесть выделение
+ * Замена держится в отдельной единице трансляции, чтобы компилятор
+ * не сопоставлял встроенные вызовы new с free
+ */
+void* operator new(size_t size) {
+    ++allocation_count;
+    if(void* memory = malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw bad_alloc();
+}
+/**
+ * Освободить память, выделенную заменённым operator new
+ */
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+/**
+ * Освободить память, выделенную заменённым operator new
+ */
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+#endif
+/**
+ * Считаются ли выделения памяти
+ */
+bool AllocationCounter::IsEnabled() noexcept {
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+/**
+ * Количество выделений памяти в текущем потоке
+ */
+size_t AllocationCounter::Count() noexcept {
+    return allocation_count;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+/**
+ * Счётчик выделений памяти в потоке - для проверки запросов без выделений.
+ * Считает глобальный operator new, заменённый в allocation_counter.cpp
+ * только при сборке с SEARCH_SERVER_COUNT_ALLOCATIONS,
+ * иначе стандартный распределитель памяти не меняется
+ */
+class AllocationCounter {
+public:
+    /**
+     * Считаются ли выделения памяти
+     */
+    static bool IsEnabled() noexcept;
+    /**
+     * Количество выделений памяти в текущем потоке
+     */
+    static size_t Count() noexcept;
+};
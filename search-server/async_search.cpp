@@ -0,0 +1,243 @@
+#include "async_search.h"
+#include "metrics.h"
+#include <algorithm>
+
+using namespace std;
+/**
+ * Описание ошибки - очередь запросов заполнена
+ */
+const char* AsyncSearch::ERROR_QUEUE_FULL = "Очередь запросов заполнена";
+/**
+ * Описание ошибки - некорректная ёмкость очереди
+ */
+const char* AsyncSearch::ERROR_QUEUE_CAPACITY = "Ёмкость очереди запросов должна быть больше нуля";
+/**
+ * Описание ошибки - запрос отменён
+ */
+const char* AsyncSearch::ERROR_CANCELLED = "Запрос отменён";
+/**
+ * Описание ошибки - истёк срок выполнения запроса
+ */
+const char* AsyncSearch::ERROR_DEADLINE = "Истёк срок выполнения запроса";
+/**
+ * Описание ошибки - обработчик остановлен до выполнения запроса
+ */
+const char* AsyncSearch::ERROR_STOPPED = "Обработчик запросов остановлен";
+/**
+ * Конструктор обработчика запросов к серверу с параметрами по умолчанию
+ */
+AsyncSearch::AsyncSearch(const SearchServer& search_server) :
+    AsyncSearch(search_server, Options{}) { }
+/**
+ * Конструктор обработчика запросов к серверу
+ */
+AsyncSearch::AsyncSearch(const SearchServer& search_server, const Options& options) :
+    server_(search_server),
+    queue_capacity_(options.queue_capacity),
+    wait_when_full_(options.wait_when_full) {
+    if(queue_capacity_ == 0) {
+        throw invalid_argument(ERROR_QUEUE_CAPACITY);
+    }
+    const size_t thread_count = options.thread_count == 0
+            ? max(1u, thread::hardware_concurrency())
+            : options.thread_count;
+    workers_.reserve(thread_count);
+    for(size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this]() {
+            Work();
+        });
+    }
+}
+/**
+ * Деструктор: начатые запросы завершаются,
+ * ожидающие снимаются с исключением Abandoned
+ */
+AsyncSearch::~AsyncSearch() {
+    deque<Task> pending;
+    {
+        lock_guard lock(mutex_);
+        stop_ = true;
+        pending.swap(queue_);
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+    for(Task& task : pending) {
+        task.run(make_exception_ptr(Abandoned(ERROR_STOPPED)));
+    }
+    for(thread& worker : workers_) {
+        worker.join();
+    }
+}
+/**
+ * Поставить в очередь поиск документов по запросу
+ * Результат передаётся функции обратного вызова
+ * Поиск идёт через кэш результатов и множества документов по статусу
+ * и прерывается на очередном окне номеров документов, если запрос отменён или просрочен
+ */
+void AsyncSearch::FindTopDocumentsAsync(std::string raw_query, const RequestOptions& options, FindCallback callback) {
+    const auto run = [this, raw_query = move(raw_query), options, callback = move(callback)](exception_ptr abandoned) {
+        if(abandoned) {
+            callback({}, abandoned);
+            return;
+        }
+        // рабочие буферы поиска свои у каждого потока обработчика
+        thread_local SearchServer::QueryContext context;
+        // отмена и срок проверяются на каждом окне номеров документов,
+        // в том числе пока обходятся списки вхождений
+        const auto interrupt = [&options]() {
+            if(const exception_ptr error = CheckAbandoned(options)) {
+                rethrow_exception(error);
+            }
+        };
+        vector<Document> documents;
+        try {
+            const vector<Document>& found = server_.FindTopDocuments(context, raw_query, options.status, options.top_count, interrupt);
+            documents.assign(found.begin(), found.end());
+        } catch(...) {
+            callback({}, current_exception());
+            return;
+        }
+        callback(move(documents), nullptr);
+    };
+    Submit(Task{options, run});
+}
+/**
+ * Поставить в очередь поиск документов по запросу
+ */
+std::future<std::vector<Document>> AsyncSearch::FindTopDocumentsAsync(std::string raw_query,
+                                                                      const RequestOptions& options) {
+    auto promise = make_shared<std::promise<vector<Document>>>();
+    future<vector<Document>> result = promise->get_future();
+    FindTopDocumentsAsync(move(raw_query), options, [promise](vector<Document> documents, exception_ptr error) {
+        if(error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(move(documents));
+        }
+    });
+    return result;
+}
+/**
+ * Поставить в очередь поиск документов по запросу с параметрами по умолчанию
+ */
+std::future<std::vector<Document>> AsyncSearch::FindTopDocumentsAsync(std::string raw_query) {
+    return FindTopDocumentsAsync(move(raw_query), RequestOptions{});
+}
+/**
+ * Поставить в очередь сопоставление запроса с документом
+ * Результат передаётся функции обратного вызова
+ */
+void AsyncSearch::MatchDocumentAsync(std::string raw_query,
+                                     int document_id,
+                                     const RequestOptions& options,
+                                     MatchCallback callback) {
+    const auto run = [this, raw_query = move(raw_query), document_id, callback = move(callback)](exception_ptr abandoned) {
+        if(abandoned) {
+            callback({}, abandoned);
+            return;
+        }
+        MatchResult result;
+        try {
+            const auto [words, status] = server_.MatchDocument(raw_query, document_id);
+            get<0>(result).assign(words.begin(), words.end());
+            get<1>(result) = status;
+        } catch(...) {
+            callback({}, current_exception());
+            return;
+        }
+        callback(move(result), nullptr);
+    };
+    Submit(Task{options, run});
+}
+/**
+ * Поставить в очередь сопоставление запроса с документом
+ */
+std::future<AsyncSearch::MatchResult> AsyncSearch::MatchDocumentAsync(std::string raw_query,
+                                                                     int document_id,
+                                                                     const RequestOptions& options) {
+    auto promise = make_shared<std::promise<MatchResult>>();
+    future<MatchResult> result = promise->get_future();
+    MatchDocumentAsync(move(raw_query), document_id, options, [promise](MatchResult match, exception_ptr error) {
+        if(error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(move(match));
+        }
+    });
+    return result;
+}
+/**
+ * Количество запросов, ожидающих выполнения
+ */
+size_t AsyncSearch::QueueSize() const {
+    lock_guard lock(mutex_);
+    return queue_.size();
+}
+/**
+ * Поставить запрос в очередь
+ * Заполненная очередь отклоняет запрос исключением std::overflow_error
+ * или, если задано ожидание, задерживает постановку до появления места;
+ * запрос, срок которого истёк во время ожидания, снимается
+ */
+void AsyncSearch::Submit(Task task) {
+    unique_lock lock(mutex_);
+    if(queue_.size() >= queue_capacity_ && !stop_) {
+        if(!wait_when_full_) {
+            METRICS_ADD("async.rejected", 1);
+            throw overflow_error(ERROR_QUEUE_FULL);
+        }
+        const auto has_room = [this]() {
+            return stop_ || queue_.size() < queue_capacity_;
+        };
+        if(task.options.deadline) {
+            if(!not_full_.wait_until(lock, *task.options.deadline, has_room)) {
+                lock.unlock();
+                METRICS_ADD("async.expired", 1);
+                task.run(make_exception_ptr(Abandoned(ERROR_DEADLINE)));
+                return;
+            }
+        } else {
+            not_full_.wait(lock, has_room);
+        }
+    }
+    if(stop_) {
+        lock.unlock();
+        task.run(make_exception_ptr(Abandoned(ERROR_STOPPED)));
+        return;
+    }
+    queue_.push_back(move(task));
+    lock.unlock();
+    not_empty_.notify_one();
+}
+/**
+ * Цикл потока обработчика
+ * Отменённые и просроченные запросы снимаются без выполнения
+ */
+void AsyncSearch::Work() {
+    while(true) {
+        unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this]() {
+            return stop_ || !queue_.empty();
+        });
+        if(queue_.empty()) return;
+        Task task = move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        task.run(CheckAbandoned(task.options));
+    }
+}
+/**
+ * Исключение для снятого запроса или nullptr, если запрос нужно выполнять
+ */
+std::exception_ptr AsyncSearch::CheckAbandoned(const RequestOptions& options) {
+    if(options.cancellation.IsCancelled()) {
+        METRICS_ADD("async.cancelled", 1);
+        return make_exception_ptr(Abandoned(ERROR_CANCELLED));
+    }
+    if(options.deadline && Clock::now() >= *options.deadline) {
+        METRICS_ADD("async.expired", 1);
+        return make_exception_ptr(Abandoned(ERROR_DEADLINE));
+    }
+    return nullptr;
+}
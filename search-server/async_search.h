@@ -0,0 +1,245 @@
+#pragma once
+#include "search_server.h"
+#include "document.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+/**
+ * Асинхронные запросы к серверу.
+ * Запросы ставятся в ограниченную очередь и выполняются потоками обработчика,
+ * результат передаётся функции обратного вызова или через std::future.
+ * Заполненная очередь отклоняет новые запросы либо задерживает их постановку.
+ * Запрос можно отменить или ограничить сроком: отменённый или просроченный
+ * запрос снимается с очереди без выполнения, а начатый прерывается
+ * на очередном окне номеров документов. Вместо результата такой запрос
+ * получает исключение Abandoned.
+ * Сервер должен существовать, пока существует обработчик
+ */
+class AsyncSearch {
+public:
+    using Clock = std::chrono::steady_clock;
+    /**
+     * Ёмкость очереди запросов по умолчанию
+     */
+    static constexpr size_t DEFAULT_QUEUE_CAPACITY = 1024;
+    /**
+     * Описание ошибки - очередь запросов заполнена
+     */
+    static const char* ERROR_QUEUE_FULL;
+    /**
+     * Описание ошибки - некорректная ёмкость очереди
+     */
+    static const char* ERROR_QUEUE_CAPACITY;
+    /**
+     * Описание ошибки - запрос отменён
+     */
+    static const char* ERROR_CANCELLED;
+    /**
+     * Описание ошибки - истёк срок выполнения запроса
+     */
+    static const char* ERROR_DEADLINE;
+    /**
+     * Описание ошибки - обработчик остановлен до выполнения запроса
+     */
+    static const char* ERROR_STOPPED;
+    /**
+     * Запрос снят без результата: отменён, просрочен или не выполнен до остановки
+     */
+    class Abandoned : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+    /**
+     * Признак отмены запроса
+     * Копии признака общие: отмена через любую копию видна всем
+     */
+    class CancellationToken {
+    public:
+        CancellationToken() :
+            cancelled_(std::make_shared<std::atomic<bool>>(false)) { }
+        /**
+         * Отменить запросы с этим признаком
+         */
+        void Cancel() const noexcept {
+            cancelled_->store(true, std::memory_order_relaxed);
+        }
+        /**
+         * Отменены ли запросы с этим признаком
+         */
+        bool IsCancelled() const noexcept {
+            return cancelled_->load(std::memory_order_relaxed);
+        }
+    private:
+        std::shared_ptr<std::atomic<bool>> cancelled_;
+    };
+    /**
+     * Параметры обработчика
+     */
+    struct Options {
+        /**
+         * Количество потоков, 0 - по количеству ядер
+         */
+        size_t thread_count = 0;
+        /**
+         * Наибольшее количество запросов, ожидающих выполнения
+         */
+        size_t queue_capacity = DEFAULT_QUEUE_CAPACITY;
+        /**
+         * Ждать места в заполненной очереди вместо отклонения запроса
+         * Ожидание ограничено сроком запроса
+         */
+        bool wait_when_full = false;
+    };
+    /**
+     * Параметры запроса
+     */
+    struct RequestOptions {
+        /**
+         * Статус документов выдачи
+         */
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        /**
+         * Наибольшее количество документов выдачи
+         */
+        size_t top_count = SearchServer::MAX_RESULT_DOCUMENT_COUNT;
+        /**
+         * Срок, после которого запрос снимается
+         */
+        std::optional<Clock::time_point> deadline;
+        /**
+         * Признак отмены запроса
+         */
+        CancellationToken cancellation;
+    };
+    /**
+     * Результат сопоставления запроса с документом
+     * Слова копируются: запрос перестаёт существовать после его выполнения
+     */
+    using MatchResult = std::tuple<std::vector<std::string>, DocumentStatus>;
+    /**
+     * Функция обратного вызова поиска: результат или исключение
+     * Вызывается в потоке обработчика и не должна выбрасывать исключений
+     */
+    using FindCallback = std::function<void(std::vector<Document> documents, std::exception_ptr error)>;
+    /**
+     * Функция обратного вызова сопоставления: результат или исключение
+     * Вызывается в потоке обработчика и не должна выбрасывать исключений
+     */
+    using MatchCallback = std::function<void(MatchResult result, std::exception_ptr error)>;
+    /**
+     * Конструктор обработчика запросов к серверу с параметрами по умолчанию
+     */
+    explicit AsyncSearch(const SearchServer& search_server);
+    /**
+     * Конструктор обработчика запросов к серверу
+     */
+    AsyncSearch(const SearchServer& search_server, const Options& options);
+    AsyncSearch(const AsyncSearch&) = delete;
+    AsyncSearch& operator=(const AsyncSearch&) = delete;
+    /**
+     * Деструктор: начатые запросы завершаются,
+     * ожидающие снимаются с исключением Abandoned
+     */
+    ~AsyncSearch();
+    /**
+     * Поставить в очередь поиск документов по запросу
+     * Результат передаётся функции обратного вызова
+     * При заполненной очереди выбрасывает std::overflow_error
+     */
+    void FindTopDocumentsAsync(std::string raw_query, const RequestOptions& options, FindCallback callback);
+    /**
+     * Поставить в очередь поиск документов по запросу
+     * При заполненной очереди выбрасывает std::overflow_error
+     */
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, const RequestOptions& options);
+    /**
+     * Поставить в очередь поиск документов по запросу с параметрами по умолчанию
+     * При заполненной очереди выбрасывает std::overflow_error
+     */
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query);
+    /**
+     * Поставить в очередь сопоставление запроса с документом
+     * Результат передаётся функции обратного вызова
+     * При заполненной очереди выбрасывает std::overflow_error
+     */
+    void MatchDocumentAsync(std::string raw_query, int document_id, const RequestOptions& options, MatchCallback callback);
+    /**
+     * Поставить в очередь сопоставление запроса с документом
+     * При заполненной очереди выбрасывает std::overflow_error
+     */
+    std::future<MatchResult> MatchDocumentAsync(std::string raw_query, int document_id, const RequestOptions& options);
+    /**
+     * Количество запросов, ожидающих выполнения
+     */
+    size_t QueueSize() const;
+private:
+    /**
+     * Запрос в очереди
+     * Функция получает исключение Abandoned, если запрос снят,
+     * или nullptr, если его нужно выполнить
+     */
+    struct Task {
+        RequestOptions options;
+        std::function<void(std::exception_ptr abandoned)> run;
+    };
+    /**
+     * Поставить запрос в очередь
+     */
+    void Submit(Task task);
+    /**
+     * Цикл потока обработчика
+     */
+    void Work();
+    /**
+     * Исключение для снятого запроса или nullptr, если запрос нужно выполнять
+     */
+    static std::exception_ptr CheckAbandoned(const RequestOptions& options);
+    /**
+     * Поисковой сервер
+     */
+    const SearchServer& server_;
+    /**
+     * Наибольшее количество запросов, ожидающих выполнения
+     */
+    size_t queue_capacity_;
+    /**
+     * Ждать места в заполненной очереди вместо отклонения запроса
+     */
+    bool wait_when_full_;
+    /**
+     * Блокировка очереди
+     */
+    mutable std::mutex mutex_;
+    /**
+     * Появление запроса в очереди или остановка
+     */
+    std::condition_variable not_empty_;
+    /**
+     * Появление места в очереди или остановка
+     */
+    std::condition_variable not_full_;
+    /**
+     * Запросы, ожидающие выполнения
+     */
+    std::deque<Task> queue_;
+    /**
+     * Обработчик остановлен
+     */
+    bool stop_ = false;
+    /**
+     * Потоки обработчика
+     */
+    std::vector<std::thread> workers_;
+};
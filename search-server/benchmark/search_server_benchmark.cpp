@@ -0,0 +1,289 @@
+#include "search_server.h"
+#include "generators.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "executor.h"
+#include <benchmark/benchmark.h>
+#include <tbb/global_control.h>
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+/**
+ * Параметры корпуса - как в main.cpp
+ */
+constexpr int DICTIONARY_SIZE = 1000;
+constexpr int MAX_WORD_LENGTH = 10;
+constexpr int DOCUMENT_WORDS = 70;
+/**
+ * Количество запросов, по кругу подаваемых в замер
+ */
+constexpr int QUERY_COUNT = 100;
+/**
+ * Доля документов, к которым добавляются дубликаты, в процентах
+ */
+constexpr int DUPLICATE_PERCENT = 10;
+/**
+ * Случайные документы с общим словарём
+ */
+struct Corpus {
+    std::vector<std::string> dictionary;
+    std::vector<std::string> documents;
+    /**
+     * Сервер со всеми документами корпуса
+     */
+    std::unique_ptr<SearchServer> server;
+};
+/**
+ * Пакет документов корпуса для добавления
+ */
+vector<SearchServer::NewDocument> MakeBatch(const vector<string>& documents) {
+    vector<SearchServer::NewDocument> batch;
+    batch.reserve(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    return batch;
+}
+/**
+ * Сервер с документами корпуса
+ */
+unique_ptr<SearchServer> MakeServer(const vector<string>& dictionary, const vector<string>& documents) {
+    auto server = make_unique<SearchServer>(dictionary[0]);
+    server->AddDocuments(execution::par, MakeBatch(documents));
+    return server;
+}
+/**
+ * Корпус из document_count документов
+ * Корпус каждого размера строится один раз и общий для всех замеров и потоков
+ */
+const Corpus& GetCorpus(int document_count) {
+    static mutex corpora_mutex;
+    static map<int, unique_ptr<Corpus>> corpora;
+    lock_guard lock(corpora_mutex);
+    auto& corpus = corpora[document_count];
+    if (corpus == nullptr) {
+        mt19937 generator;
+        corpus = make_unique<Corpus>();
+        corpus->dictionary = GenerateDictionary(generator, DICTIONARY_SIZE, MAX_WORD_LENGTH);
+        corpus->documents = GenerateQueries(generator, corpus->dictionary, document_count, DOCUMENT_WORDS);
+        corpus->server = MakeServer(corpus->dictionary, corpus->documents);
+    }
+    return *corpus;
+}
+/**
+ * Запросы по словарю корпуса с заданной длиной и долей минус-слов в процентах
+ * Запросы одинаковы для всех потоков замера
+ */
+vector<string> MakeQueries(const Corpus& corpus, int64_t word_count, int64_t minus_percent) {
+    mt19937 generator(static_cast<mt19937::result_type>(word_count * 100 + minus_percent));
+    return GenerateQueries(generator, corpus.dictionary, QUERY_COUNT, static_cast<int>(word_count), minus_percent / 100.);
+}
+/**
+ * Количества потоков для перебора: степени двойки до числа ядер, но не меньше двух
+ */
+vector<int64_t> ThreadCounts() {
+    const int64_t max_threads = max<int64_t>(2, thread::hardware_concurrency());
+    vector<int64_t> counts;
+    for (int64_t count = 1; count <= max_threads; count *= 2) {
+        counts.push_back(count);
+    }
+    return counts;
+}
+/**
+ * Перебор размера корпуса, длины запроса и доли минус-слов
+ */
+void QueryArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"docs", "words", "minus%"})
+             ->ArgsProduct({{1'000, 10'000}, {5, 20, 70}, {0, 10}})
+             ->Unit(benchmark::kMicrosecond);
+}
+/**
+ * Перебор размера корпуса, длины запроса, доли минус-слов и количества потоков TBB
+ */
+void ParallelQueryArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"docs", "words", "minus%", "threads"})
+             ->ArgsProduct({{1'000, 10'000}, {5, 20, 70}, {0, 10}, ThreadCounts()})
+             ->Unit(benchmark::kMicrosecond);
+}
+/**
+ * Ограничение потоков многопоточных алгоритмов на время замера
+ */
+tbb::global_control LimitThreads(int64_t thread_count) {
+    return tbb::global_control(tbb::global_control::max_allowed_parallelism, static_cast<size_t>(thread_count));
+}
+/**
+ * Исполнитель с заданным количеством потоков
+ */
+Executor MakeExecutor(int64_t thread_count) {
+    Executor::Options options;
+    options.thread_count = static_cast<size_t>(thread_count);
+    return Executor(options);
+}
+/**
+ * Поиск по запросам корпуса: потоки замера ищут одновременно
+ */
+template <typename ExecutionPolicy>
+void FindTopDocuments(benchmark::State& state, ExecutionPolicy policy) {
+    const Corpus& corpus = GetCorpus(static_cast<int>(state.range(0)));
+    const vector<string> queries = MakeQueries(corpus, state.range(1), state.range(2));
+    size_t query = static_cast<size_t>(state.thread_index());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(corpus.server->FindTopDocuments(policy, queries[query++ % queries.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+/**
+ * Сопоставление запросов корпуса с его документами по кругу
+ */
+template <typename ExecutionPolicy>
+void MatchDocument(benchmark::State& state, ExecutionPolicy policy) {
+    const Corpus& corpus = GetCorpus(static_cast<int>(state.range(0)));
+    const vector<string> queries = MakeQueries(corpus, state.range(1), state.range(2));
+    const int document_count = static_cast<int>(corpus.documents.size());
+    size_t iteration = static_cast<size_t>(state.thread_index());
+    for (auto _ : state) {
+        const int document_id = static_cast<int>(iteration * 7919 % document_count);
+        benchmark::DoNotOptimize(corpus.server->MatchDocument(policy, queries[iteration % queries.size()], document_id));
+        ++iteration;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_AddDocument(benchmark::State& state) {
+    const Corpus& corpus = GetCorpus(static_cast<int>(state.range(0)));
+    unique_ptr<SearchServer> server;
+    for (auto _ : state) {
+        state.PauseTiming();
+        server = make_unique<SearchServer>(corpus.dictionary[0]);
+        state.ResumeTiming();
+        for (size_t i = 0; i < corpus.documents.size(); ++i) {
+            server->AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * corpus.documents.size());
+}
+BENCHMARK(BM_AddDocument)->ArgName("docs")->Arg(1'000)->Arg(10'000)->Unit(benchmark::kMillisecond);
+
+void BM_FindTopDocumentsSeq(benchmark::State& state) {
+    FindTopDocuments(state, execution::seq);
+}
+BENCHMARK(BM_FindTopDocumentsSeq)->Apply(QueryArguments)->ThreadRange(1, ThreadCounts().back())->UseRealTime();
+
+void BM_FindTopDocumentsPar(benchmark::State& state) {
+    const auto limit = LimitThreads(state.range(3));
+    FindTopDocuments(state, execution::par);
+}
+BENCHMARK(BM_FindTopDocumentsPar)->Apply(ParallelQueryArguments)->UseRealTime();
+
+void BM_FindTopDocumentsExecutor(benchmark::State& state) {
+    FindTopDocuments(state, MakeExecutor(state.range(3)));
+}
+BENCHMARK(BM_FindTopDocumentsExecutor)->Apply(ParallelQueryArguments)->UseRealTime();
+
+void BM_MatchDocumentSeq(benchmark::State& state) {
+    MatchDocument(state, execution::seq);
+}
+BENCHMARK(BM_MatchDocumentSeq)->Apply(QueryArguments)->ThreadRange(1, ThreadCounts().back())->UseRealTime();
+
+void BM_MatchDocumentPar(benchmark::State& state) {
+    const auto limit = LimitThreads(state.range(3));
+    MatchDocument(state, execution::par);
+}
+BENCHMARK(BM_MatchDocumentPar)->Apply(ParallelQueryArguments)->UseRealTime();
+
+void BM_MatchDocumentExecutor(benchmark::State& state) {
+    MatchDocument(state, MakeExecutor(state.range(3)));
+}
+BENCHMARK(BM_MatchDocumentExecutor)->Apply(ParallelQueryArguments)->UseRealTime();
+
+void BM_RemoveDocument(benchmark::State& state) {
+    const Corpus& corpus = GetCorpus(static_cast<int>(state.range(0)));
+    unique_ptr<SearchServer> server;
+    for (auto _ : state) {
+        state.PauseTiming();
+        server = MakeServer(corpus.dictionary, corpus.documents);
+        state.ResumeTiming();
+        for (size_t i = 0; i < corpus.documents.size(); ++i) {
+            server->RemoveDocument(static_cast<int>(i));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * corpus.documents.size());
+}
+BENCHMARK(BM_RemoveDocument)->ArgName("docs")->Arg(1'000)->Arg(10'000)->Unit(benchmark::kMillisecond);
+
+void BM_RemoveDocuments(benchmark::State& state) {
+    const Corpus& corpus = GetCorpus(static_cast<int>(state.range(0)));
+    vector<int> document_ids(corpus.documents.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        document_ids[i] = static_cast<int>(i);
+    }
+    unique_ptr<SearchServer> server;
+    for (auto _ : state) {
+        state.PauseTiming();
+        server = MakeServer(corpus.dictionary, corpus.documents);
+        state.ResumeTiming();
+        server->RemoveDocuments(document_ids);
+    }
+    state.SetItemsProcessed(state.iterations() * document_ids.size());
+}
+BENCHMARK(BM_RemoveDocuments)->ArgName("docs")->Arg(1'000)->Arg(10'000)->Unit(benchmark::kMillisecond);
+
+void BM_ProcessQueries(benchmark::State& state) {
+    const auto limit = LimitThreads(state.range(3));
+    const Corpus& corpus = GetCorpus(static_cast<int>(state.range(0)));
+    const vector<string> queries = MakeQueries(corpus, state.range(1), state.range(2));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ProcessQueries(*corpus.server, queries));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_ProcessQueries)->Apply(ParallelQueryArguments)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_ProcessQueriesExecutor(benchmark::State& state) {
+    const Executor executor = MakeExecutor(state.range(3));
+    const Corpus& corpus = GetCorpus(static_cast<int>(state.range(0)));
+    const vector<string> queries = MakeQueries(corpus, state.range(1), state.range(2));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ProcessQueries(executor, *corpus.server, queries));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_ProcessQueriesExecutor)->Apply(ParallelQueryArguments)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_RemoveDuplicates(benchmark::State& state) {
+    const Corpus& corpus = GetCorpus(static_cast<int>(state.range(0)));
+    // к корпусу добавляются копии части документов
+    vector<string> documents = corpus.documents;
+    const size_t duplicate_count = corpus.documents.size() * DUPLICATE_PERCENT / 100;
+    for (size_t i = 0; i < duplicate_count; ++i) {
+        documents.push_back(corpus.documents[i * 100 / DUPLICATE_PERCENT]);
+    }
+    unique_ptr<SearchServer> server;
+    // сообщения о найденных дубликатах не выводятся
+    streambuf* const output = cout.rdbuf(nullptr);
+    for (auto _ : state) {
+        state.PauseTiming();
+        server = MakeServer(corpus.dictionary, documents);
+        state.ResumeTiming();
+        RemoveDuplicates(*server);
+    }
+    cout.rdbuf(output);
+    state.SetItemsProcessed(state.iterations() * documents.size());
+    state.counters["duplicates"] = static_cast<double>(duplicate_count);
+}
+BENCHMARK(BM_RemoveDuplicates)->ArgName("docs")->Arg(1'000)->Arg(10'000)->Unit(benchmark::kMillisecond);
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,162 @@
+#include "bit_packing.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+/**
+ * Количество дорожек
+ */
+const size_t LANES = 4;
+/**
+ * Количество строк блока - чисел в одной дорожке
+ */
+const size_t ROWS = BitPacking::BLOCK_SIZE / LANES;
+/**
+ * Маска младших bits разрядов
+ */
+uint32_t LowMask(uint32_t bits) {
+    return bits == 32 ? UINT32_MAX : (1u << bits) - 1;
+}
+#ifdef __SSE2__
+/**
+ * Распаковать блок четвёрками чисел
+ * При Delta числа восстанавливаются накоплением разностей от base
+ */
+template <bool Delta>
+void UnpackBlock(const uint32_t* packed, uint32_t bits, uint32_t base, uint32_t* values) {
+    __m128i* out = reinterpret_cast<__m128i*>(values);
+    __m128i previous = _mm_set1_epi32(static_cast<int>(base));
+    if(bits == 0) {
+        const __m128i value = Delta ? previous : _mm_setzero_si128();
+        for(size_t row = 0; row < ROWS; ++row) {
+            _mm_storeu_si128(out + row, value);
+        }
+        return;
+    }
+    const __m128i* in = reinterpret_cast<const __m128i*>(packed);
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(LowMask(bits)));
+    __m128i current = _mm_loadu_si128(in++);
+    uint32_t shift = 0;
+    for(size_t row = 0; row < ROWS; ++row) {
+        __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(static_cast<int>(shift)));
+        shift += bits;
+        if(shift > 32) {
+            // число начинается в текущем слове и продолжается в следующем
+            current = _mm_loadu_si128(in++);
+            shift -= 32;
+            value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128(static_cast<int>(bits - shift))));
+        } else if(shift == 32 && row + 1 < ROWS) {
+            current = _mm_loadu_si128(in++);
+            shift = 0;
+        }
+        value = _mm_and_si128(value, mask);
+        if(Delta) {
+            previous = _mm_add_epi32(previous, value);
+            value = previous;
+        }
+        _mm_storeu_si128(out + row, value);
+    }
+}
+#else
+/**
+ * Распаковать блок по дорожкам
+ * При Delta числа восстанавливаются накоплением разностей от base
+ */
+template <bool Delta>
+void UnpackBlock(const uint32_t* packed, uint32_t bits, uint32_t base, uint32_t* values) {
+    const uint32_t mask = LowMask(bits);
+    for(size_t lane = 0; lane < LANES; ++lane) {
+        uint32_t previous = base;
+        const uint32_t* in = packed + lane;
+        uint32_t current = bits == 0 ? 0 : *in;
+        uint32_t shift = 0;
+        for(size_t row = 0; row < ROWS; ++row) {
+            uint32_t value = bits == 0 ? 0 : current >> shift;
+            shift += bits;
+            if(shift > 32) {
+                in += LANES;
+                current = *in;
+                shift -= 32;
+                value |= current << (bits - shift);
+            } else if(shift == 32 && row + 1 < ROWS) {
+                in += LANES;
+                current = *in;
+                shift = 0;
+            }
+            value &= mask;
+            if(Delta) {
+                previous += value;
+                value = previous;
+            }
+            values[row * LANES + lane] = value;
+        }
+    }
+}
+#endif
+}
+/**
+ * Разрядность, достаточная для всех чисел блока
+ */
+uint32_t BitPacking::MaxBits(const uint32_t* values) {
+    uint32_t accumulated = 0;
+    for(size_t i = 0; i < BLOCK_SIZE; ++i) {
+        accumulated |= values[i];
+    }
+    uint32_t bits = 0;
+    for(; accumulated != 0; accumulated >>= 1) {
+        ++bits;
+    }
+    return bits;
+}
+/**
+ * Упаковать блок чисел разрядности bits в PackedWords(bits) слов
+ */
+void BitPacking::Pack(const uint32_t* values, uint32_t bits, uint32_t* packed) {
+    if(bits == 0) {
+        return;
+    }
+    for(size_t lane = 0; lane < LANES; ++lane) {
+        uint64_t accumulated = 0;
+        uint32_t filled = 0;
+        uint32_t* out = packed + lane;
+        for(size_t row = 0; row < ROWS; ++row) {
+            accumulated |= static_cast<uint64_t>(values[row * LANES + lane] & LowMask(bits)) << filled;
+            filled += bits;
+            if(filled >= 32) {
+                *out = static_cast<uint32_t>(accumulated);
+                out += LANES;
+                accumulated >>= 32;
+                filled -= 32;
+            }
+        }
+    }
+}
+/**
+ * Распаковать блок чисел разрядности bits
+ */
+void BitPacking::Unpack(const uint32_t* packed, uint32_t bits, uint32_t* values) {
+    UnpackBlock<false>(packed, bits, 0, values);
+}
+/**
+ * Упаковать возрастающую последовательность разностями с шагом 4
+ * Разности первых четырёх чисел берутся от base
+ * Возвращает разрядность упакованных разностей
+ */
+uint32_t BitPacking::PackDelta(const uint32_t* values, uint32_t base, uint32_t* packed) {
+    uint32_t deltas[BLOCK_SIZE];
+    for(size_t i = 0; i < BLOCK_SIZE; ++i) {
+        deltas[i] = values[i] - (i < LANES ? base : values[i - LANES]);
+    }
+    const uint32_t bits = MaxBits(deltas);
+    Pack(deltas, bits, packed);
+    return bits;
+}
+/**
+ * Распаковать возрастающую последовательность, упакованную PackDelta
+ */
+void BitPacking::UnpackDelta(const uint32_t* packed, uint32_t bits, uint32_t base, uint32_t* values) {
+    UnpackBlock<true>(packed, bits, base, values);
+}
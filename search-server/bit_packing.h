@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+/**
+ * Упаковка блоков из 128 целых чисел фиксированной разрядности.
+ * Числа раскладываются "вертикально" по четырём 32-битным дорожкам:
+ * i-е число попадает в дорожку i % 4, поэтому распаковка идёт сразу
+ * четвёрками чисел на SSE2 (без SSE2 - скалярный вариант того же формата)
+ */
+class BitPacking {
+public:
+    /**
+     * Количество чисел в блоке
+     */
+    static const size_t BLOCK_SIZE = 128;
+    /**
+     * Количество 32-битных слов упакованного блока разрядности bits
+     */
+    static size_t PackedWords(uint32_t bits) {
+        return BLOCK_SIZE / 32 * bits;
+    }
+    /**
+     * Разрядность, достаточная для всех чисел блока
+     */
+    static uint32_t MaxBits(const uint32_t* values);
+    /**
+     * Упаковать блок чисел разрядности bits в PackedWords(bits) слов
+     */
+    static void Pack(const uint32_t* values, uint32_t bits, uint32_t* packed);
+    /**
+     * Распаковать блок чисел разрядности bits
+     */
+    static void Unpack(const uint32_t* packed, uint32_t bits, uint32_t* values);
+    /**
+     * Упаковать возрастающую последовательность разностями с шагом 4
+     * Разности первых четырёх чисел берутся от base
+     * Возвращает разрядность упакованных разностей
+     */
+    static uint32_t PackDelta(const uint32_t* values, uint32_t base, uint32_t* packed);
+    /**
+     * Распаковать возрастающую последовательность, упакованную PackDelta
+     */
+    static void UnpackDelta(const uint32_t* packed, uint32_t bits, uint32_t base, uint32_t* values);
+};
@@ -12,11 +12,16 @@ const char* Document::ERROR_DOCUMENT_ID = "Некорректный иденти
  */
 const char* Document::ERROR_DOCUMENT_INDEX = "Некорректный индекс документа";
 /**
- * Оператор сравнения <
+ * Оператор сравнения <: лучший документ меньше
+ * Документы с равными релевантностью и рейтингом упорядочены по id,
+ * поэтому порядок выдачи однозначен и страницы не пересекаются
  */
 bool Document::operator<(const Document& doc) const {
     if (abs(relevance - doc.relevance) < numeric_limits<double>::epsilon()) {
-        return rating > doc.rating;
+        if (rating != doc.rating) {
+            return rating > doc.rating;
+        }
+        return id < doc.id;
     }
     return relevance > doc.relevance;
 }
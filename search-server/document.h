@@ -21,7 +21,9 @@ public:
         relevance(relevance),
         rating(rating) { }
     /**
-     * Оператор сравнения <
+     * Оператор сравнения <: лучший документ меньше
+     * Документы с равными релевантностью и рейтингом упорядочены по id,
+     * поэтому порядок выдачи однозначен и страницы не пересекаются
      */
     bool operator<(const Document& doc) const;
     /**
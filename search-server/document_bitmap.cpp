@@ -0,0 +1,110 @@
+#include "document_bitmap.h"
+#include <algorithm>
+
+using namespace std;
+/**
+ * Количество 64-битных слов битовой карты участка
+ */
+static const size_t CONTAINER_WORDS = 65536 / 64;
+/**
+ * Добавить номер
+ */
+void DocumentBitmap::Add(uint32_t ordinal) {
+    if(Contains(ordinal)) {
+        return;
+    }
+    Container& container = MutableContainer(ordinal >> 16);
+    const uint16_t low = static_cast<uint16_t>(ordinal);
+    if(!container.bits.empty()) {
+        container.bits[low >> 6] |= uint64_t{1} << (low & 63);
+    } else {
+        // номера обычно добавляются по возрастанию - дописываем в конец
+        auto it = container.array.end();
+        if(!container.array.empty() && container.array.back() > low) {
+            it = lower_bound(container.array.begin(), container.array.end(), low);
+        }
+        container.array.insert(it, low);
+        if(container.array.size() > ARRAY_LIMIT) {
+            ConvertToBits(container);
+        }
+    }
+    ++container.cardinality;
+    ++size_;
+}
+/**
+ * Удалить номер
+ */
+void DocumentBitmap::Remove(uint32_t ordinal) {
+    if(!Contains(ordinal)) {
+        return;
+    }
+    Container& container = MutableContainer(ordinal >> 16);
+    const uint16_t low = static_cast<uint16_t>(ordinal);
+    --container.cardinality;
+    --size_;
+    if(!container.bits.empty()) {
+        container.bits[low >> 6] &= ~(uint64_t{1} << (low & 63));
+        if(container.cardinality <= ARRAY_LIMIT) {
+            ConvertToArray(container);
+        }
+    } else {
+        container.array.erase(lower_bound(container.array.begin(), container.array.end(), low));
+    }
+}
+/**
+ * Объём множества в байтах
+ */
+size_t DocumentBitmap::MemoryUsage() const noexcept {
+    size_t usage = containers_.capacity() * sizeof(shared_ptr<Container>);
+    for(const auto& container : containers_) {
+        if(container == nullptr) continue;
+        usage += sizeof(Container) +
+                 container->array.capacity() * sizeof(uint16_t) +
+                 container->bits.capacity() * sizeof(uint64_t);
+    }
+    return usage;
+}
+/**
+ * Содержит ли участок-массив младшие биты номера
+ */
+bool DocumentBitmap::ContainsInArray(const Container& container, uint16_t low) {
+    return binary_search(container.array.begin(), container.array.end(), low);
+}
+/**
+ * Перевести участок из массива в битовую карту
+ */
+void DocumentBitmap::ConvertToBits(Container& container) {
+    container.bits.assign(CONTAINER_WORDS, 0);
+    for(const uint16_t low : container.array) {
+        container.bits[low >> 6] |= uint64_t{1} << (low & 63);
+    }
+    vector<uint16_t>().swap(container.array);
+}
+/**
+ * Перевести участок из битовой карты в массив
+ */
+void DocumentBitmap::ConvertToArray(Container& container) {
+    container.array.clear();
+    container.array.reserve(container.cardinality);
+    for(size_t word_index = 0; word_index < CONTAINER_WORDS; ++word_index) {
+        for(uint64_t word = container.bits[word_index]; word != 0; word &= word - 1) {
+            container.array.push_back(static_cast<uint16_t>((word_index << 6) + __builtin_ctzll(word)));
+        }
+    }
+    vector<uint64_t>().swap(container.bits);
+}
+/**
+ * Участок для изменения, общий с другими копиями участок копируется
+ */
+DocumentBitmap::Container& DocumentBitmap::MutableContainer(size_t high) {
+    if(high >= containers_.size()) {
+        containers_.resize(high + 1);
+    }
+    shared_ptr<Container>& container = containers_[high];
+    if(container == nullptr) {
+        container = make_shared<Container>();
+    } else if(container.use_count() > 1) {
+        container = make_shared<Container>(*container);
+    }
+    return *container;
+}
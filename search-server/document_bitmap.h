@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+/**
+ * Сжатое множество внутренних номеров документов в духе Roaring.
+ * Номера делятся на участки по старшим 16 битам, каждый участок
+ * хранится упорядоченным массивом младших 16 бит, пока в нём не больше
+ * ARRAY_LIMIT номеров, и битовой картой на 65536 бит - если больше.
+ * Копии множества делят неизменённые участки: изменение сначала копирует
+ * участок, если тот принадлежит нескольким копиям
+ */
+class DocumentBitmap {
+public:
+    /**
+     * Наибольшее количество номеров в участке, хранимом массивом
+     */
+    static constexpr size_t ARRAY_LIMIT = 512;
+    /**
+     * Добавить номер
+     */
+    void Add(uint32_t ordinal);
+    /**
+     * Удалить номер
+     */
+    void Remove(uint32_t ordinal);
+    /**
+     * Содержит ли множество номер
+     */
+    bool Contains(uint32_t ordinal) const {
+        const size_t high = ordinal >> 16;
+        if(high >= containers_.size()) {
+            return false;
+        }
+        const Container* container = containers_[high].get();
+        if(container == nullptr) {
+            return false;
+        }
+        const uint16_t low = static_cast<uint16_t>(ordinal);
+        if(!container->bits.empty()) {
+            return (container->bits[low >> 6] >> (low & 63)) & 1;
+        }
+        return ContainsInArray(*container, low);
+    }
+    /**
+     * Количество номеров
+     */
+    size_t size() const noexcept {
+        return size_;
+    }
+    /**
+     * Объём множества в байтах
+     */
+    size_t MemoryUsage() const noexcept;
+    /**
+     * Обойти номера из диапазона [begin, end) по возрастанию
+     */
+    template <typename Function>
+    void ForEachInRange(uint32_t begin, uint32_t end, Function function) const;
+private:
+    /**
+     * Участок из 65536 номеров с общими старшими битами
+     */
+    struct Container {
+        /**
+         * Младшие биты номеров по возрастанию, если участок хранится массивом
+         */
+        std::vector<uint16_t> array;
+        /**
+         * Битовая карта, если участок хранится картой, иначе пуста
+         */
+        std::vector<uint64_t> bits;
+        /**
+         * Количество номеров в участке
+         */
+        uint32_t cardinality = 0;
+    };
+    /**
+     * Содержит ли участок-массив младшие биты номера
+     */
+    static bool ContainsInArray(const Container& container, uint16_t low);
+    /**
+     * Перевести участок из массива в битовую карту
+     */
+    static void ConvertToBits(Container& container);
+    /**
+     * Перевести участок из битовой карты в массив
+     */
+    static void ConvertToArray(Container& container);
+    /**
+     * Участок для изменения, общий с другими копиями участок копируется
+     */
+    Container& MutableContainer(size_t high);
+    /**
+     * Участки по старшим 16 битам номеров, пустые участки могут не храниться
+     */
+    std::vector<std::shared_ptr<Container>> containers_;
+    /**
+     * Количество номеров
+     */
+    size_t size_ = 0;
+};
+/**
+ * Обойти номера из диапазона [begin, end) по возрастанию
+ * Битовые карты обходятся словами, пустые слова пропускаются целиком
+ */
+template <typename Function>
+void DocumentBitmap::ForEachInRange(uint32_t begin, uint32_t end, Function function) const {
+    for(size_t high = begin >> 16; high < containers_.size() && (high << 16) < end; ++high) {
+        if(containers_[high] == nullptr) continue;
+        const Container& container = *containers_[high];
+        const uint32_t base = static_cast<uint32_t>(high << 16);
+        const uint32_t low_begin = begin > base ? begin - base : 0;
+        const uint32_t low_end = end - base < 65536 ? end - base : 65536;
+        if(container.bits.empty()) {
+            for(const uint16_t low : container.array) {
+                if(low >= low_end) {
+                    break;
+                }
+                if(low >= low_begin) {
+                    function(base + low);
+                }
+            }
+            continue;
+        }
+        for(uint32_t word_index = low_begin >> 6; word_index < (low_end + 63) >> 6; ++word_index) {
+            uint64_t word = container.bits[word_index];
+            const uint32_t word_base = word_index << 6;
+            // обрезаем слово по границам диапазона
+            if(word_base < low_begin) {
+                word &= ~uint64_t{0} << (low_begin - word_base);
+            }
+            if(low_end - word_base < 64) {
+                word &= (uint64_t{1} << (low_end - word_base)) - 1;
+            }
+            while(word != 0) {
+                const uint32_t bit = static_cast<uint32_t>(__builtin_ctzll(word));
+                function(base + word_base + bit);
+                word &= word - 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#include "epoch_manager.h"
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+/**
+ * Закрепить текущую эпоху
+ * Поток начинает поиск свободной ячейки со своей, чтобы не делить её с другими
+ * Ячейка и опубликованный указатель читаются с последовательной согласованностью:
+ * писатель, не увидевший ячейку занятой, опубликовал новую версию раньше, чем
+ * читатель её прочитает
+ */
+EpochManager::Guard EpochManager::Pin() const {
+    static atomic<size_t> next_thread_slot{0};
+    thread_local const size_t thread_slot = next_thread_slot.fetch_add(1, memory_order_relaxed);
+    for(size_t attempt = 0;; ++attempt) {
+        auto& slot = slots_[(thread_slot + attempt) % READER_SLOTS].epoch;
+        uint64_t expected = FREE_SLOT;
+        if(slot.compare_exchange_strong(expected, epoch_.load())) {
+            return Guard(&slot);
+        }
+        // все ячейки заняты - ждём, пока какой-нибудь читатель закончит
+        if(attempt % READER_SLOTS == READER_SLOTS - 1) {
+            this_thread::yield();
+        }
+    }
+}
+/**
+ * Передать снятые с публикации данные на освобождение
+ * Вызывается писателем после публикации новой версии
+ */
+void EpochManager::Retire(std::shared_ptr<const void> object) {
+    lock_guard guard(retired_mutex_);
+    retired_.push_back({epoch_.fetch_add(1), move(object)});
+}
+/**
+ * Освободить данные, которые уже не может читать ни один читатель
+ * Данные, снятые в эпоху e, может читать только читатель, закрепивший эпоху не позже e
+ */
+void EpochManager::Reclaim() {
+    uint64_t oldest = UINT64_MAX;
+    for(const ReaderSlot& slot : slots_) {
+        const uint64_t epoch = slot.epoch.load();
+        if(epoch != FREE_SLOT) {
+            oldest = min(oldest, epoch);
+        }
+    }
+    vector<RetiredObject> released;
+    {
+        lock_guard guard(retired_mutex_);
+        const auto last = find_if(retired_.begin(), retired_.end(), [oldest](const RetiredObject& retired) {
+            return retired.epoch >= oldest;
+        });
+        released.assign(make_move_iterator(retired_.begin()), make_move_iterator(last));
+        retired_.erase(retired_.begin(), last);
+    }
+    // данные освобождаются вне блокировки списка
+}
+/**
+ * Количество данных, ожидающих освобождения
+ */
+size_t EpochManager::RetiredCount() const {
+    lock_guard guard(retired_mutex_);
+    return retired_.size();
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+/**
+ * Освобождение данных по эпохам для читателей без блокировок.
+ * Читатель закрепляет текущую эпоху на время чтения опубликованных данных,
+ * писатель публикует новую версию и передаёт старую в Retire.
+ * Старая версия освобождается, когда все читатели, закрепившие эпоху
+ * не позже её снятия с публикации, закончили чтение
+ */
+class EpochManager {
+public:
+    /**
+     * Закреплённая эпоха читателя, снимается в деструкторе
+     */
+    class Guard {
+    public:
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard() {
+            slot_->store(FREE_SLOT, std::memory_order_release);
+        }
+    private:
+        friend class EpochManager;
+        explicit Guard(std::atomic<uint64_t>* slot) :
+            slot_(slot) { }
+        /**
+         * Ячейка читателя с закреплённой эпохой
+         */
+        std::atomic<uint64_t>* slot_;
+    };
+    EpochManager() = default;
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+    /**
+     * Закрепить текущую эпоху
+     * Опубликованные данные читаются только после закрепления
+     */
+    Guard Pin() const;
+    /**
+     * Передать снятые с публикации данные на освобождение
+     * Вызывается писателем после публикации новой версии
+     */
+    void Retire(std::shared_ptr<const void> object);
+    /**
+     * Освободить данные, которые уже не может читать ни один читатель
+     */
+    void Reclaim();
+    /**
+     * Количество данных, ожидающих освобождения
+     */
+    size_t RetiredCount() const;
+private:
+    /**
+     * Количество ячеек одновременно читающих потоков
+     */
+    static constexpr size_t READER_SLOTS = 64;
+    /**
+     * Значение свободной ячейки
+     */
+    static constexpr uint64_t FREE_SLOT = 0;
+    /**
+     * Ячейка читателя на отдельной кэш-линии
+     */
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{FREE_SLOT};
+    };
+    /**
+     * Данные, снятые с публикации в эпоху epoch
+     */
+    struct RetiredObject {
+        uint64_t epoch;
+        std::shared_ptr<const void> object;
+    };
+    /**
+     * Ячейки читателей
+     */
+    mutable std::array<ReaderSlot, READER_SLOTS> slots_;
+    /**
+     * Текущая эпоха, растёт при каждом снятии данных с публикации
+     */
+    std::atomic<uint64_t> epoch_{1};
+    /**
+     * Блокировка списка ожидающих освобождения
+     */
+    mutable std::mutex retired_mutex_;
+    /**
+     * Ожидающие освобождения данные по возрастанию эпох
+     */
+    std::vector<RetiredObject> retired_;
+};
@@ -0,0 +1,323 @@
+#include "executor.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+/**
+ * Пул потоков исполнителя
+ */
+class Executor::Pool {
+public:
+    explicit Pool(const Options& options);
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+    ~Pool();
+    /**
+     * Выполнить цикл на пуле порциями по grain индексов
+     */
+    void Run(size_t count, size_t grain, RangeFunction range, const void* function);
+    /**
+     * Количество потоков, выполняющих цикл, включая вызывающий
+     */
+    const size_t thread_count;
+    /**
+     * Циклы со стоимостью ниже порога выполняются последовательно
+     */
+    const size_t sequential_threshold;
+    /**
+     * Количество порций на поток, если размер порции не задан
+     */
+    const size_t chunks_per_thread;
+private:
+    /**
+     * Выполняемый цикл, живёт в стеке вызывающего потока до конца цикла
+     */
+    struct Batch {
+        RangeFunction range;
+        const void* function;
+        /**
+         * Количество невыполненных порций
+         */
+        atomic<size_t> pending{0};
+        /**
+         * Первое исключение из порций
+         */
+        mutex error_mutex;
+        exception_ptr error;
+    };
+    /**
+     * Порция цикла
+     */
+    struct Task {
+        Batch* batch;
+        size_t begin;
+        size_t end;
+    };
+    /**
+     * Очередь порций потока
+     */
+    struct alignas(64) Queue {
+        mutex queue_mutex;
+        deque<Task> tasks;
+    };
+    /**
+     * Цикл потока пула с номером worker
+     */
+    void Work(size_t worker);
+    /**
+     * Выполнить одну порцию цикла batch (nullptr - любого): из очереди queue
+     * с конца или украденную из других очередей с начала
+     * Возвращает false, если подходящих порций в очередях нет
+     */
+    bool RunTask(size_t queue, const Batch* batch);
+    /**
+     * Выполнить порцию и отметить её выполнение
+     */
+    static void Execute(const Task& task);
+    /**
+     * Закрепить текущий поток за ядром
+     */
+    static void PinToCore(size_t core);
+    /**
+     * Очереди порций по номерам потоков пула
+     */
+    vector<unique_ptr<Queue>> queues_;
+    /**
+     * Потоки пула
+     */
+    vector<thread> workers_;
+    /**
+     * Количество порций в очередях
+     */
+    atomic<size_t> queued_{0};
+    /**
+     * Очередь, с которой внешний поток начинает раскладывать порции
+     */
+    atomic<size_t> next_queue_{0};
+    /**
+     * Ожидание порций свободными потоками
+     */
+    mutex sleep_mutex_;
+    condition_variable wake_;
+    bool stop_ = false;
+};
+namespace {
+/**
+ * Пул, потоком которого является текущий поток, и номер потока в нём
+ */
+thread_local const void* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+}
+/**
+ * Конструктор пула: вызывающий поток выполняет порции сам,
+ * поэтому потоков пула на один меньше заданного
+ */
+Executor::Pool::Pool(const Options& options) :
+    thread_count(max<size_t>(1, options.thread_count == 0 ? thread::hardware_concurrency() : options.thread_count)),
+    sequential_threshold(options.sequential_threshold),
+    chunks_per_thread(max<size_t>(1, options.chunks_per_thread)) {
+    const size_t worker_count = thread_count - 1;
+    for(size_t worker = 0; worker < worker_count; ++worker) {
+        queues_.push_back(make_unique<Queue>());
+    }
+    workers_.reserve(worker_count);
+    for(size_t worker = 0; worker < worker_count; ++worker) {
+        workers_.emplace_back([this, worker, pin = options.pin_threads]() {
+            if(pin) {
+                PinToCore(worker);
+            }
+            Work(worker);
+        });
+    }
+}
+/**
+ * Деструктор: потоки пула завершаются после опустошения очередей
+ */
+Executor::Pool::~Pool() {
+    {
+        lock_guard lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for(thread& worker : workers_) {
+        worker.join();
+    }
+}
+/**
+ * Выполнить цикл на пуле порциями по grain индексов
+ * Поток пула кладёт порции в свою очередь, внешний поток - по всем очередям по кругу
+ * Вызывающий поток выполняет порции, пока не выполнены все порции цикла
+ * Ожидая, он выполняет только порции своего цикла: чужая порция могла бы
+ * занять буферы потока, которыми пользуется прерванный ожиданием код
+ * Пул из одного потока не имеет очередей и выполняет цикл сам
+ */
+void Executor::Pool::Run(size_t count, size_t grain, RangeFunction range, const void* function) {
+    if(queues_.empty()) {
+        range(function, 0, count);
+        return;
+    }
+    if(grain == 0) {
+        const size_t chunk_count = thread_count * chunks_per_thread;
+        grain = (count + chunk_count - 1) / chunk_count;
+    }
+    grain = max<size_t>(1, grain);
+    const size_t chunk_count = (count + grain - 1) / grain;
+    Batch batch;
+    batch.range = range;
+    batch.function = function;
+    batch.pending.store(chunk_count, memory_order_relaxed);
+    const bool own_thread = current_pool == this;
+    const size_t first_queue = own_thread ? current_worker : next_queue_.fetch_add(1, memory_order_relaxed) % queues_.size();
+    size_t queued = 0;
+    exception_ptr queue_error;
+    try {
+        for(; queued < chunk_count; ++queued) {
+            const size_t queue = own_thread ? first_queue : (first_queue + queued) % queues_.size();
+            const Task task{&batch, queued * grain, min(count, (queued + 1) * grain)};
+            lock_guard lock(queues_[queue]->queue_mutex);
+            queues_[queue]->tasks.push_back(task);
+        }
+    } catch(...) {
+        // порции, уже попавшие в очереди, ссылаются на цикл в стеке этого потока:
+        // ошибка передаётся только после их выполнения
+        queue_error = current_exception();
+        batch.pending.fetch_sub(chunk_count - queued, memory_order_acq_rel);
+    }
+    queued_.fetch_add(queued, memory_order_release);
+    {
+        lock_guard lock(sleep_mutex_);
+    }
+    wake_.notify_all();
+    while(batch.pending.load(memory_order_acquire) > 0) {
+        if(!RunTask(first_queue, &batch)) {
+            this_thread::yield();
+        }
+    }
+    if(queue_error) {
+        rethrow_exception(queue_error);
+    }
+    if(batch.error) {
+        rethrow_exception(batch.error);
+    }
+}
+/**
+ * Цикл потока пула с номером worker
+ */
+void Executor::Pool::Work(size_t worker) {
+    current_pool = this;
+    current_worker = worker;
+    while(true) {
+        if(RunTask(worker, nullptr)) continue;
+        unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this]() {
+            return stop_ || queued_.load(memory_order_acquire) > 0;
+        });
+        if(stop_ && queued_.load(memory_order_acquire) == 0) return;
+    }
+}
+/**
+ * Выполнить одну порцию цикла batch (nullptr - любого): из очереди queue
+ * с конца или украденную из других очередей с начала
+ * Возвращает false, если подходящих порций в очередях нет
+ */
+bool Executor::Pool::RunTask(size_t queue, const Batch* batch) {
+    if(queued_.load(memory_order_acquire) == 0) return false;
+    const auto matches = [batch](const Task& task) {
+        return batch == nullptr || task.batch == batch;
+    };
+    for(size_t i = 0; i < queues_.size(); ++i) {
+        Queue& victim = *queues_[(queue + i) % queues_.size()];
+        optional<Task> task;
+        {
+            lock_guard lock(victim.queue_mutex);
+            auto& tasks = victim.tasks;
+            // своя очередь - с конца, пока порции ещё в кэше, чужая - с начала
+            if(i == 0) {
+                const auto it = find_if(tasks.rbegin(), tasks.rend(), matches);
+                if(it == tasks.rend()) continue;
+                task = *it;
+                tasks.erase(prev(it.base()));
+            } else {
+                const auto it = find_if(tasks.begin(), tasks.end(), matches);
+                if(it == tasks.end()) continue;
+                task = *it;
+                tasks.erase(it);
+            }
+        }
+        queued_.fetch_sub(1, memory_order_relaxed);
+        Execute(*task);
+        return true;
+    }
+    return false;
+}
+/**
+ * Выполнить порцию и отметить её выполнение
+ * Отметка - последнее обращение к циклу: после неё вызывающий поток может его завершить
+ */
+void Executor::Pool::Execute(const Task& task) {
+    Batch& batch = *task.batch;
+    try {
+        batch.range(batch.function, task.begin, task.end);
+    } catch(...) {
+        lock_guard lock(batch.error_mutex);
+        if(!batch.error) {
+            batch.error = current_exception();
+        }
+    }
+    batch.pending.fetch_sub(1, memory_order_acq_rel);
+}
+/**
+ * Закрепить текущий поток за ядром
+ * Вне Linux потоки не закрепляются
+ */
+void Executor::Pool::PinToCore(size_t core) {
+#ifdef __linux__
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core % max(1u, thread::hardware_concurrency()), &cores);
+    pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+#else
+    (void)core;
+#endif
+}
+/**
+ * Конструктор пула с параметрами по умолчанию
+ */
+Executor::Executor() :
+    Executor(Options{}) { }
+/**
+ * Конструктор пула с заданными параметрами
+ */
+Executor::Executor(const Options& options) :
+    pool_(make_shared<Pool>(options)) { }
+/**
+ * Количество потоков, выполняющих цикл, включая вызывающий
+ */
+size_t Executor::ThreadCount() const noexcept {
+    return pool_->thread_count;
+}
+/**
+ * Количество потоков для работы стоимостью cost:
+ * 1, если работа выполняется последовательно
+ */
+size_t Executor::Parallelism(size_t cost) const noexcept {
+    if(pool_->thread_count <= 1 || cost < pool_->sequential_threshold) {
+        return 1;
+    }
+    return pool_->thread_count;
+}
+/**
+ * Выполнить цикл на пуле порциями по grain индексов
+ */
+void Executor::Run(size_t count, size_t grain, RangeFunction range, const void* function) const {
+    pool_->Run(count, grain, range, function);
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+/**
+ * Исполнитель параллельных циклов на постоянном пуле потоков.
+ * Цикл делится на порции, порции кладутся в очереди потоков пула,
+ * свободный поток берёт порции из своей очереди с конца,
+ * а опустевший - крадёт из чужих очередей с начала (work stealing).
+ * Вызывающий поток тоже выполняет порции, пока цикл не закончится,
+ * поэтому вложенные циклы не блокируют пул.
+ * Цикл, оценка стоимости которого ниже порога, выполняется последовательно
+ * в вызывающем потоке без обращения к пулу.
+ * Исполнитель - лёгкий описатель пула: копии делят один пул,
+ * поэтому его можно передавать вместо стандартных политик исполнения
+ */
+class Executor {
+public:
+    /**
+     * Порог стоимости по умолчанию: примерно столько вхождений документов
+     * обходится быстрее, чем запускается параллельный цикл
+     */
+    static constexpr size_t DEFAULT_SEQUENTIAL_THRESHOLD = 16384;
+    /**
+     * Количество порций на поток по умолчанию
+     */
+    static constexpr size_t DEFAULT_CHUNKS_PER_THREAD = 4;
+    /**
+     * Параметры пула
+     */
+    struct Options {
+        /**
+         * Количество потоков, выполняющих цикл, включая вызывающий
+         * 0 - по количеству ядер
+         */
+        size_t thread_count = 0;
+        /**
+         * Закрепить потоки пула за ядрами по порядку
+         */
+        bool pin_threads = false;
+        /**
+         * Циклы со стоимостью ниже порога выполняются последовательно
+         */
+        size_t sequential_threshold = DEFAULT_SEQUENTIAL_THRESHOLD;
+        /**
+         * Количество порций на поток, если размер порции не задан
+         */
+        size_t chunks_per_thread = DEFAULT_CHUNKS_PER_THREAD;
+    };
+    /**
+     * Конструктор пула с параметрами по умолчанию
+     */
+    Executor();
+    /**
+     * Конструктор пула с заданными параметрами
+     */
+    explicit Executor(const Options& options);
+    /**
+     * Количество потоков, выполняющих цикл, включая вызывающий
+     */
+    size_t ThreadCount() const noexcept;
+    /**
+     * Количество потоков для работы стоимостью cost:
+     * 1, если работа выполняется последовательно
+     */
+    size_t Parallelism(size_t cost) const noexcept;
+    /**
+     * Вызвать function(index) для индексов [0, count)
+     * cost - оценка стоимости всего цикла, grain - наименьшее количество
+     * индексов в порции (0 - по количеству потоков и порций на поток)
+     * Первое исключение из function передаётся вызывающему после завершения цикла
+     */
+    template <typename Function>
+    void ParallelFor(size_t count, Function function, size_t cost, size_t grain = 0) const;
+    /**
+     * Вызвать function(index) для индексов [0, count)
+     * Стоимость цикла оценивается количеством индексов
+     */
+    template <typename Function>
+    void ParallelFor(size_t count, Function function) const {
+        ParallelFor(count, function, count);
+    }
+private:
+    class Pool;
+    /**
+     * Порция цикла: вызывает функцию цикла для индексов [begin, end)
+     */
+    using RangeFunction = void (*)(const void* function, size_t begin, size_t end);
+    /**
+     * Выполнить цикл на пуле порциями по grain индексов
+     */
+    void Run(size_t count, size_t grain, RangeFunction range, const void* function) const;
+    /**
+     * Общий пул копий исполнителя
+     */
+    std::shared_ptr<Pool> pool_;
+};
+/**
+ * Вызвать function(index) для индексов [0, count)
+ * cost - оценка стоимости всего цикла, grain - наименьшее количество
+ * индексов в порции (0 - по количеству потоков и порций на поток)
+ * Первое исключение из function передаётся вызывающему после завершения цикла
+ */
+template <typename Function>
+void Executor::ParallelFor(size_t count, Function function, size_t cost, size_t grain) const {
+    if(count <= 1 || Parallelism(cost) <= 1) {
+        for(size_t index = 0; index < count; ++index) {
+            function(index);
+        }
+        return;
+    }
+    const RangeFunction range = [](const void* function, size_t begin, size_t end) {
+        const auto& call = *static_cast<const Function*>(function);
+        for(size_t index = begin; index < end; ++index) {
+            call(index);
+        }
+    };
+    Run(count, grain, range, &function);
+}
+/**
+ * Количество потоков политики исполнения для работы стоимостью cost
+ * Стандартная многопоточная политика всегда использует все ядра
+ */
+template <typename ExecutionPolicy>
+size_t PolicyParallelism(const ExecutionPolicy& policy, size_t cost) {
+    if constexpr(std::is_same_v<ExecutionPolicy, Executor>) {
+        return policy.Parallelism(cost);
+    } else if constexpr(std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        return 1;
+    } else {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+/**
+ * Вызвать function(index) для индексов [0, count) с политикой исполнения:
+ * стандартной или исполнителем с оценкой стоимости цикла cost
+ */
+template <typename ExecutionPolicy, typename Function>
+void PolicyForEach(const ExecutionPolicy& policy, size_t count, size_t cost, Function function) {
+    if constexpr(std::is_same_v<ExecutionPolicy, Executor>) {
+        policy.ParallelFor(count, function, cost);
+    } else if constexpr(std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        for(size_t index = 0; index < count; ++index) {
+            function(index);
+        }
+    } else {
+        std::vector<size_t> indexes(count);
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(policy, indexes.begin(), indexes.end(), function);
+    }
+}
@@ -0,0 +1,61 @@
+#include "generators.h"
+#include <algorithm>
+
+using namespace std;
+/**
+ * Случайное слово из строчных латинских букв длиной от 1 до max_length
+ */
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+/**
+ * Словарь из word_count случайных слов длиной до max_length
+ */
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+/**
+ * Запрос из word_count случайных слов словаря
+ * Каждое слово с вероятностью minus_prob становится минус-словом
+ */
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+/**
+ * query_count запросов по max_word_count случайных слов словаря
+ * Каждое слово с вероятностью minus_prob становится минус-словом
+ */
+vector<string> GenerateQueries(mt19937& generator,
+                               const vector<string>& dictionary,
+                               int query_count,
+                               int max_word_count,
+                               double minus_prob) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count, minus_prob));
+    }
+    return queries;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <random>
+#include <string>
+#include <vector>
+/**
+ * Генераторы случайных слов, словарей и запросов
+ * для замеров производительности поисковой системы
+ */
+/**
+ * Случайное слово из строчных латинских букв длиной от 1 до max_length
+ */
+std::string GenerateWord(std::mt19937& generator, int max_length);
+/**
+ * Словарь из word_count случайных слов длиной до max_length
+ */
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+/**
+ * Запрос из word_count случайных слов словаря
+ * Каждое слово с вероятностью minus_prob становится минус-словом
+ */
+std::string GenerateQuery(std::mt19937& generator,
+                          const std::vector<std::string>& dictionary,
+                          int word_count,
+                          double minus_prob = 0);
+/**
+ * query_count запросов по max_word_count случайных слов словаря
+ * Каждое слово с вероятностью minus_prob становится минус-словом
+ */
+std::vector<std::string> GenerateQueries(std::mt19937& generator,
+                                         const std::vector<std::string>& dictionary,
+                                         int query_count,
+                                         int max_word_count,
+                                         double minus_prob = 0);
@@ -0,0 +1,334 @@
+#include "index_segment.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+using namespace std;
+/**
+ * Пустое множество документов
+ */
+const DocumentBitmap IndexSegment::EMPTY_DOCUMENTS = {};
+/**
+ * Слить подряд идущие сегменты в один
+ * Удалённые документы сохраняют свои номера, но не занимают списки вхождений
+ * Слияние одного сегмента вычищает вхождения помеченных удалёнными документов
+ * Записи документов переходят в новый сегмент без копирования
+ */
+IndexSegment IndexSegment::Merge(const std::vector<std::shared_ptr<IndexSegment>>& segments) {
+    IndexSegment merged(segments.front()->first_ordinal_);
+    for(const auto& segment : segments) {
+        // документы переносятся с прежними номерами, отметки статусов - только у неудалённых
+        // записи помеченных удалёнными документов теряют слова
+        segment->documents_.ForEach([&merged, &segment](size_t offset, const shared_ptr<DocumentRecord>& document) {
+            const auto ordinal = static_cast<uint32_t>(segment->first_ordinal_ + offset);
+            if(document->terms.empty() || segment->live_documents_.Contains(ordinal)) {
+                merged.documents_.push_back(document);
+            } else {
+                merged.documents_.push_back(make_shared<DocumentRecord>(DocumentRecord{document->id, document->data, {}}));
+            }
+        });
+        segment->live_documents_.ForEachInRange(segment->first_ordinal_, segment->EndOrdinal(), [&](uint32_t ordinal) {
+            merged.MarkLive(ordinal, segment->Document(ordinal).data.status);
+        });
+        // диапазоны сегментов следуют по возрастанию - списки вхождений
+        // сливаются дописыванием в конец
+        segment->postings_.ForEach([&merged, &segment](size_t term, const shared_ptr<PostingList>& source) {
+            if(source == nullptr) return;
+            PostingList& postings = merged.MutablePostings(static_cast<uint32_t>(term));
+            source->ForEach([&postings, &segment](uint32_t ordinal, double frequency) {
+                if(segment->removed_documents_ == 0 || segment->live_documents_.Contains(ordinal)) {
+                    postings.Add(ordinal, frequency);
+                }
+            });
+            if(postings.empty()) {
+                merged.postings_.Mutable(term).reset();
+            }
+        });
+    }
+    merged.Seal();
+    return merged;
+}
+/**
+ * Дописать документ с готовыми словами прямого индекса со следующим внутренним номером
+ * Списки вхождений не меняются: их прикрепляет AttachPostings
+ */
+void IndexSegment::AppendDocument(int document_id, DocumentData data, DocumentTerms terms) {
+    const uint32_t ordinal = EndOrdinal();
+    documents_.push_back(make_shared<DocumentRecord>(DocumentRecord{document_id, data, move(terms)}));
+    MarkLive(ordinal, data.status);
+}
+/**
+ * Дописать документ со следующим внутренним номером
+ * Слова документа переданы идентификаторами в порядке следования
+ */
+void IndexSegment::AddDocument(int document_id, DocumentData data, std::vector<uint32_t>& words) {
+    const uint32_t ordinal = EndOrdinal();
+    auto document = make_shared<DocumentRecord>(MakeDocument(document_id, data, words));
+    // каждое слово документа попадает в список вхождений один раз
+    for(const DocumentTerm& term : document->terms) {
+        MutablePostings(term.term).Add(ordinal, term.tf);
+    }
+    documents_.push_back(move(document));
+    MarkLive(ordinal, data.status);
+}
+/**
+ * Запись документа по идентификаторам слов в порядке следования
+ * Слова сортируются, повторы слова наращивают text frequency
+ */
+IndexSegment::DocumentRecord IndexSegment::MakeDocument(int document_id, DocumentData data, std::vector<uint32_t>& words) {
+    const double tf_increment = 1./ words.size();
+    DocumentRecord document{document_id, data, {}};
+    auto& terms = document.terms;
+    sort(words.begin(), words.end());
+    for(auto it = words.begin(); it != words.end();) {
+        const auto last = upper_bound(it, words.end(), *it);
+        double tf = 0;
+        for(; it != last; ++it) {
+            tf += tf_increment;
+        }
+        terms.push_back({*(last - 1), tf});
+    }
+    return document;
+}
+/**
+ * Построить закрытый сегмент из записей документов, начиная с внутреннего номера
+ */
+IndexSegment IndexSegment::Build(uint32_t first_ordinal, std::vector<DocumentRecord> documents) {
+    IndexSegment segment(first_ordinal);
+    for(DocumentRecord& document : documents) {
+        const uint32_t ordinal = segment.EndOrdinal();
+        for(const DocumentTerm& term : document.terms) {
+            segment.MutablePostings(term.term).Add(ordinal, term.tf);
+        }
+        segment.MarkLive(ordinal, document.data.status);
+        segment.documents_.push_back(make_shared<DocumentRecord>(move(document)));
+    }
+    segment.Seal();
+    return segment;
+}
+/**
+ * Построить закрытый сегмент из записей документов, начиная с внутреннего номера
+ * Документы делятся на участки по числу потоков, для каждого участка строится
+ * частичный обратный индекс: вхождения раскладываются по словам сортировкой
+ * подсчётом, внутри слова номера документов возрастают.
+ * Участки занимают возрастающие диапазоны номеров, поэтому слияние частичных
+ * индексов сводится к дописыванию их вхождений по порядку участков:
+ * диапазоны идентификаторов слов сливаются независимо и параллельно
+ */
+IndexSegment IndexSegment::Build(const std::execution::parallel_policy&,
+                                 uint32_t first_ordinal,
+                                 std::vector<DocumentRecord> documents) {
+    IndexSegment segment(first_ordinal);
+    if(documents.empty()) {
+        return segment;
+    }
+    // вхождение слова в документ частичного индекса
+    struct Entry {
+        uint32_t ordinal;
+        double tf;
+    };
+    // частичный индекс: вхождения слова term - [offsets[term], offsets[term + 1])
+    struct Part {
+        vector<size_t> offsets;
+        vector<Entry> entries;
+    };
+    const size_t term_end = transform_reduce(execution::par,
+                                             documents.begin(), documents.end(),
+                                             size_t{0},
+                                             [](size_t lhs, size_t rhs) { return max(lhs, rhs); },
+                                             [](const DocumentRecord& document) {
+        return document.terms.empty() ? size_t{0} : size_t{document.terms.back().term} + 1;
+    });
+    const size_t part_count = min<size_t>(documents.size(), max(1u, thread::hardware_concurrency()));
+    vector<Part> parts(part_count);
+    vector<size_t> part_indexes(part_count);
+    iota(part_indexes.begin(), part_indexes.end(), 0);
+    for_each(execution::par,
+             part_indexes.begin(), part_indexes.end(),
+             [&](size_t part) {
+        const size_t begin = documents.size() * part / part_count;
+        const size_t end = documents.size() * (part + 1) / part_count;
+        vector<size_t>& offsets = parts[part].offsets;
+        offsets.assign(term_end + 1, 0);
+        for(size_t i = begin; i < end; ++i) {
+            for(const DocumentTerm& term : documents[i].terms) {
+                ++offsets[term.term + 1];
+            }
+        }
+        partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+        vector<Entry>& entries = parts[part].entries;
+        entries.resize(offsets.back());
+        for(size_t i = begin; i < end; ++i) {
+            const auto ordinal = first_ordinal + static_cast<uint32_t>(i);
+            for(const DocumentTerm& term : documents[i].terms) {
+                entries[positions[term.term]++] = {ordinal, term.tf};
+            }
+        }
+    });
+    // диапазонов слов больше, чем потоков, - для выравнивания нагрузки
+    const size_t range_count = min(term_end, part_count * 4);
+    vector<shared_ptr<PostingList>> postings(term_end);
+    vector<size_t> range_indexes(range_count);
+    iota(range_indexes.begin(), range_indexes.end(), 0);
+    for_each(execution::par,
+             range_indexes.begin(), range_indexes.end(),
+             [&](size_t range) {
+        const size_t first_term = term_end * range / range_count;
+        const size_t last_term = term_end * (range + 1) / range_count;
+        for(size_t term = first_term; term < last_term; ++term) {
+            shared_ptr<PostingList> term_postings;
+            for(const Part& part : parts) {
+                for(size_t i = part.offsets[term]; i < part.offsets[term + 1]; ++i) {
+                    if(term_postings == nullptr) {
+                        term_postings = make_shared<PostingList>();
+                    }
+                    term_postings->Add(part.entries[i].ordinal, part.entries[i].tf);
+                }
+            }
+            if(term_postings != nullptr) {
+                term_postings->Compact();
+                postings[term] = move(term_postings);
+            }
+        }
+    });
+    parts.clear();
+    for(size_t term = 0; term < term_end; ++term) {
+        if(postings[term] != nullptr) {
+            segment.postings_.Mutable(term) = move(postings[term]);
+        }
+    }
+    for(DocumentRecord& document : documents) {
+        const uint32_t ordinal = segment.EndOrdinal();
+        segment.MarkLive(ordinal, document.data.status);
+        segment.documents_.push_back(make_shared<DocumentRecord>(move(document)));
+    }
+    return segment;
+}
+/**
+ * Прикрепить готовый список вхождений слова без распаковки
+ * Прямой индекс не меняется: слова документов задаёт AppendDocument
+ * Номера документов списка должны возрастать и лежать в диапазоне сегмента
+ */
+void IndexSegment::AttachPostings(uint32_t term, PostingList postings) {
+    if(!postings.empty()) {
+        postings_.Mutable(term) = make_shared<PostingList>(move(postings));
+    }
+}
+/**
+ * Закрыть сегмент для дописывания: сжать хвосты списков вхождений
+ */
+void IndexSegment::Seal() {
+    vector<uint32_t> terms;
+    postings_.ForEach([&terms](size_t term, const shared_ptr<PostingList>& postings) {
+        if(postings != nullptr) {
+            terms.push_back(static_cast<uint32_t>(term));
+        }
+    });
+    for(const uint32_t term : terms) {
+        MutablePostings(term).Compact();
+    }
+}
+/**
+ * Удалить документы сегмента по внутренним номерам по возрастанию
+ * Список вхождений каждого слова перестраивается один раз
+ */
+void IndexSegment::RemoveDocuments(const std::vector<uint32_t>& ordinals) {
+    // вхождения документов группируются по словам, номера внутри слова возрастают
+    vector<pair<uint32_t, uint32_t>> entries;
+    for(const uint32_t ordinal : ordinals) {
+        for(const DocumentTerm& term : Document(ordinal).terms) {
+            entries.emplace_back(term.term, ordinal);
+        }
+    }
+    sort(entries.begin(), entries.end());
+    vector<uint32_t> term_ordinals;
+    for(auto it = entries.begin(); it != entries.end();) {
+        const uint32_t term = it->first;
+        term_ordinals.clear();
+        for(; it != entries.end() && it->first == term; ++it) {
+            term_ordinals.push_back(it->second);
+        }
+        PostingList& postings = MutablePostings(term);
+        postings.Remove(term_ordinals);
+        if(postings.empty()) {
+            postings_.Mutable(term).reset();
+        }
+    }
+    for(const uint32_t ordinal : ordinals) {
+        const DocumentRecord& document = Document(ordinal);
+        UnmarkLive(ordinal, document.data.status);
+        documents_.Mutable(ordinal - first_ordinal_) = make_shared<DocumentRecord>(DocumentRecord{document.id, document.data, {}});
+    }
+}
+/**
+ * Пометить документ сегмента удалённым
+ * Вхождения документа остаются в списках до слияния или уплотнения сегмента,
+ * а запросы пропускают его по множеству неудалённых документов
+ * Слова документа сохраняются в его записи до вычищения
+ */
+void IndexSegment::MarkRemoved(uint32_t ordinal) {
+    UnmarkLive(ordinal, Document(ordinal).data.status);
+    ++removed_documents_;
+}
+/**
+ * Внутренние номера неудалённых документов с заданным статусом
+ */
+const DocumentBitmap& IndexSegment::StatusDocuments(DocumentStatus status) const {
+    const auto index = static_cast<size_t>(status);
+    return index < DOCUMENT_STATUS_COUNT ? status_documents_[index] : EMPTY_DOCUMENTS;
+}
+/**
+ * Объём сжатых списков вхождений в байтах
+ */
+size_t IndexSegment::PostingsMemoryUsage() const noexcept {
+    size_t usage = 0;
+    postings_.ForEach([&usage](size_t, const shared_ptr<PostingList>& postings) {
+        if(postings != nullptr) {
+            usage += postings->MemoryUsage();
+        }
+    });
+    return usage;
+}
+/**
+ * Отметить документ неудалённым
+ */
+void IndexSegment::MarkLive(uint32_t ordinal, DocumentStatus status) {
+    live_documents_.Add(ordinal);
+    // документ с недопустимым статусом не попадает ни в одно множество статусов
+    if(static_cast<size_t>(status) < DOCUMENT_STATUS_COUNT) {
+        status_documents_[static_cast<size_t>(status)].Add(ordinal);
+    }
+}
+/**
+ * Снять отметки неудалённого документа
+ */
+void IndexSegment::UnmarkLive(uint32_t ordinal, DocumentStatus status) {
+    live_documents_.Remove(ordinal);
+    if(static_cast<size_t>(status) < DOCUMENT_STATUS_COUNT) {
+        status_documents_[static_cast<size_t>(status)].Remove(ordinal);
+    }
+}
+/**
+ * Список вхождений слова для изменения, создаётся при отсутствии
+ * Общий с другими копиями сегмента список копируется
+ */
+PostingList& IndexSegment::MutablePostings(uint32_t term) {
+    shared_ptr<PostingList>& postings = postings_.Mutable(term);
+    if(postings == nullptr) {
+        postings = make_shared<PostingList>();
+    } else if(postings.use_count() > 1) {
+        postings = make_shared<PostingList>(*postings);
+    }
+    return *postings;
+}
+/**
+ * Документ для изменения, общая с другими копиями запись копируется
+ */
+IndexSegment::DocumentRecord& IndexSegment::MutableDocument(uint32_t ordinal) {
+    shared_ptr<DocumentRecord>& document = documents_.Mutable(ordinal - first_ordinal_);
+    if(document.use_count() > 1) {
+        document = make_shared<DocumentRecord>(*document);
+    }
+    return *document;
+}
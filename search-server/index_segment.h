@@ -0,0 +1,281 @@
+#pragma once
+#include "document.h"
+#include "posting_list.h"
+#include "document_bitmap.h"
+#include "persistent_array.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <memory>
+#include <vector>
+/**
+ * Сегмент индекса: документы с внутренними номерами из непрерывного
+ * диапазона [FirstOrdinal(), EndOrdinal()), их списки вхождений по
+ * идентификаторам слов и прямой индекс.
+ * Новые документы дописываются только в конец диапазона.
+ * Сегмент, доступный читателям, не изменяется - писатель меняет его копию.
+ * Копия делит с исходным сегментом списки вхождений, записи документов
+ * и участки множеств, а изменение копирует только затронутые из них
+ */
+class IndexSegment {
+public:
+    /**
+     * Количество статусов документа
+     */
+    static constexpr size_t DOCUMENT_STATUS_COUNT = static_cast<size_t>(DocumentStatus::REMOVED) + 1;
+    /**
+     * Слово документа в прямом индексе
+     */
+    struct DocumentTerm {
+        /**
+         * Идентификатор слова
+         */
+        uint32_t term;
+        /**
+         * Text frequency слова в документе
+         */
+        double tf;
+    };
+    /**
+     * Слова документа в прямом индексе
+     * Слова хранятся в самой записи или, у документов из снимка,
+     * читаются из отображённого в память файла
+     * Изменение слов из файла копирует их в запись
+     */
+    class DocumentTerms {
+    public:
+        DocumentTerms() = default;
+        /**
+         * Слова, лежащие вне записи: память должна жить дольше записи
+         */
+        DocumentTerms(const DocumentTerm* terms, size_t size) noexcept :
+            view_(terms),
+            view_size_(size) { }
+        const DocumentTerm* begin() const noexcept {
+            return view_ != nullptr ? view_ : owned_.data();
+        }
+        const DocumentTerm* end() const noexcept {
+            return begin() + size();
+        }
+        size_t size() const noexcept {
+            return view_ != nullptr ? view_size_ : owned_.size();
+        }
+        bool empty() const noexcept {
+            return size() == 0;
+        }
+        const DocumentTerm& back() const {
+            return end()[-1];
+        }
+        /**
+         * Дописать слово в конец
+         */
+        void push_back(const DocumentTerm& term) {
+            if(view_ != nullptr) {
+                owned_.assign(begin(), end());
+                view_ = nullptr;
+            }
+            owned_.push_back(term);
+        }
+    private:
+        /**
+         * Слова, хранящиеся в записи
+         */
+        std::vector<DocumentTerm> owned_;
+        /**
+         * Слова вне записи или nullptr
+         */
+        const DocumentTerm* view_ = nullptr;
+        size_t view_size_ = 0;
+    };
+    /**
+     * Загруженный документ
+     */
+    struct DocumentRecord {
+        /**
+         * Идентификатор документа
+         */
+        int id;
+        /**
+         * Рейтинг и статус документа
+         */
+        DocumentData data;
+        /**
+         * Слова документа по возрастанию идентификаторов
+         */
+        DocumentTerms terms;
+    };
+    /**
+     * Конструктор пустого сегмента, начинающегося с внутреннего номера
+     */
+    explicit IndexSegment(uint32_t first_ordinal) :
+        first_ordinal_(first_ordinal) { }
+    /**
+     * Слить подряд идущие сегменты в один
+     * Удалённые документы сохраняют свои номера, но не занимают списки вхождений
+     * Слияние одного сегмента вычищает вхождения помеченных удалёнными документов
+     */
+    static IndexSegment Merge(const std::vector<std::shared_ptr<IndexSegment>>& segments);
+    /**
+     * Первый внутренний номер сегмента
+     */
+    uint32_t FirstOrdinal() const noexcept {
+        return first_ordinal_;
+    }
+    /**
+     * Внутренний номер, следующий за последним документом сегмента
+     */
+    uint32_t EndOrdinal() const noexcept {
+        return first_ordinal_ + static_cast<uint32_t>(documents_.size());
+    }
+    /**
+     * Количество внутренних номеров сегмента, включая удалённые документы
+     */
+    size_t Span() const noexcept {
+        return documents_.size();
+    }
+    /**
+     * Дописать документ с готовыми словами прямого индекса со следующим внутренним номером
+     * Списки вхождений не меняются: их прикрепляет AttachPostings
+     */
+    void AppendDocument(int document_id, DocumentData data, DocumentTerms terms);
+    /**
+     * Дописать документ со следующим внутренним номером
+     * Слова документа переданы идентификаторами в порядке следования
+     */
+    void AddDocument(int document_id, DocumentData data, std::vector<uint32_t>& words);
+    /**
+     * Запись документа по идентификаторам слов в порядке следования
+     */
+    static DocumentRecord MakeDocument(int document_id, DocumentData data, std::vector<uint32_t>& words);
+    /**
+     * Построить закрытый сегмент из записей документов, начиная с внутреннего номера
+     */
+    static IndexSegment Build(uint32_t first_ordinal, std::vector<DocumentRecord> documents);
+    /**
+     * Построить закрытый сегмент из записей документов, начиная с внутреннего номера
+     * Частичные обратные индексы участков документов строятся параллельно
+     * и сливаются параллельно по диапазонам идентификаторов слов
+     */
+    static IndexSegment Build(const std::execution::parallel_policy&,
+                              uint32_t first_ordinal,
+                              std::vector<DocumentRecord> documents);
+    /**
+     * Прикрепить готовый список вхождений слова без распаковки
+     * Прямой индекс не меняется: слова документов задаёт AppendDocument
+     * Номера документов списка должны возрастать и лежать в диапазоне сегмента
+     */
+    void AttachPostings(uint32_t term, PostingList postings);
+    /**
+     * Закрыть сегмент для дописывания: сжать хвосты списков вхождений
+     */
+    void Seal();
+    /**
+     * Удалить документы сегмента по внутренним номерам по возрастанию
+     * Список вхождений каждого слова перестраивается один раз
+     */
+    void RemoveDocuments(const std::vector<uint32_t>& ordinals);
+    /**
+     * Пометить документ сегмента удалённым
+     * Вхождения документа остаются в списках до слияния или уплотнения сегмента,
+     * а запросы пропускают его по множеству неудалённых документов
+     */
+    void MarkRemoved(uint32_t ordinal);
+    /**
+     * Количество документов, помеченных удалёнными, чьи вхождения ещё не вычищены
+     */
+    size_t RemovedDocuments() const noexcept {
+        return removed_documents_;
+    }
+    /**
+     * Список вхождений слова или nullptr, если слово не встречается в сегменте
+     */
+    const PostingList* FindPostings(uint32_t term) const {
+        const auto* postings = postings_.Find(term);
+        return postings == nullptr ? nullptr : postings->get();
+    }
+    /**
+     * Обойти непустые списки вхождений по возрастанию идентификаторов слов
+     * Функциональный объект получает идентификатор слова и список
+     */
+    template <typename Function>
+    void ForEachPostings(Function function) const;
+    /**
+     * Документ по внутреннему номеру из диапазона сегмента
+     */
+    const DocumentRecord& Document(uint32_t ordinal) const {
+        return *documents_[ordinal - first_ordinal_];
+    }
+    /**
+     * Внутренние номера неудалённых документов
+     */
+    const DocumentBitmap& LiveDocuments() const noexcept {
+        return live_documents_;
+    }
+    /**
+     * Внутренние номера неудалённых документов с заданным статусом
+     */
+    const DocumentBitmap& StatusDocuments(DocumentStatus status) const;
+    /**
+     * Объём сжатых списков вхождений в байтах
+     */
+    size_t PostingsMemoryUsage() const noexcept;
+private:
+    /**
+     * Пустое множество документов
+     */
+    static const DocumentBitmap EMPTY_DOCUMENTS;
+    /**
+     * Отметить документ неудалённым
+     */
+    void MarkLive(uint32_t ordinal, DocumentStatus status);
+    /**
+     * Снять отметки неудалённого документа
+     */
+    void UnmarkLive(uint32_t ordinal, DocumentStatus status);
+    /**
+     * Список вхождений слова для изменения, создаётся при отсутствии
+     * Общий с другими копиями сегмента список копируется
+     */
+    PostingList& MutablePostings(uint32_t term);
+    /**
+     * Документ для изменения, общая с другими копиями запись копируется
+     */
+    DocumentRecord& MutableDocument(uint32_t ordinal);
+    /**
+     * Первый внутренний номер сегмента
+     */
+    uint32_t first_ordinal_;
+    /**
+     * Списки вхождений по идентификатору слова, вместо пустых списков nullptr
+     */
+    PersistentArray<std::shared_ptr<PostingList>> postings_;
+    /**
+     * Документы по внутреннему номеру со сдвигом на первый номер сегмента
+     */
+    PersistentArray<std::shared_ptr<DocumentRecord>> documents_;
+    /**
+     * Внутренние номера неудалённых документов
+     */
+    DocumentBitmap live_documents_;
+    /**
+     * Внутренние номера неудалённых документов по статусу
+     */
+    std::array<DocumentBitmap, DOCUMENT_STATUS_COUNT> status_documents_;
+    /**
+     * Количество документов, помеченных удалёнными, чьи вхождения ещё не вычищены
+     */
+    size_t removed_documents_ = 0;
+};
+/**
+ * Обойти непустые списки вхождений по возрастанию идентификаторов слов
+ * Функциональный объект получает идентификатор слова и список
+ */
+template <typename Function>
+void IndexSegment::ForEachPostings(Function function) const {
+    postings_.ForEach([&function](size_t term, const std::shared_ptr<PostingList>& postings) {
+        if(postings != nullptr && !postings->empty()) {
+            function(static_cast<uint32_t>(term), *postings);
+        }
+    });
+}
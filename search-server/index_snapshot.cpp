@@ -0,0 +1,228 @@
+#include "index_snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+/**
+ * Описание ошибки - не удалось открыть или записать файл снимка
+ */
+const char* IndexSnapshot::ERROR_SNAPSHOT_IO = "Ошибка ввода-вывода файла снимка";
+/**
+ * Описание ошибки - файл не является снимком поддерживаемой версии
+ */
+const char* IndexSnapshot::ERROR_SNAPSHOT_FORMAT = "Некорректный формат файла снимка";
+/**
+ * Описание ошибки - контрольная сумма снимка не совпадает
+ */
+const char* IndexSnapshot::ERROR_SNAPSHOT_CHECKSUM = "Контрольная сумма снимка не совпадает";
+/**
+ * Конструктор.
+ * Отображает файл в память целиком
+ */
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw runtime_error(IndexSnapshot::ERROR_SNAPSHOT_IO + " '"s + path + "'"s);
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw runtime_error(IndexSnapshot::ERROR_SNAPSHOT_IO + " '"s + path + "'"s);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if(size_ == 0) {
+        close(fd);
+        return;
+    }
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // отображение остаётся действительным после закрытия файла
+    if(data == MAP_FAILED) {
+        throw runtime_error(IndexSnapshot::ERROR_SNAPSHOT_IO + " '"s + path + "'"s);
+    }
+    data_ = static_cast<const char*>(data);
+}
+MappedFile::~MappedFile() {
+    if(data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+/**
+ * Учесть очередной фрагмент данных
+ */
+void IndexSnapshot::Checksum::Update(const char* data, size_t size) {
+    // дополняем неполное слово, оставшееся от прошлого фрагмента
+    while(tail_size_ > 0 && tail_size_ < sizeof(uint64_t) && size > 0) {
+        tail_ |= static_cast<uint64_t>(static_cast<unsigned char>(*data)) << (8 * tail_size_);
+        ++tail_size_;
+        ++data;
+        --size;
+    }
+    if(tail_size_ == sizeof(uint64_t)) {
+        hash_ = Mix(hash_, tail_);
+        tail_ = 0;
+        tail_size_ = 0;
+    }
+    for(; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        hash_ = Mix(hash_, word);
+    }
+    for(; size > 0; ++data, --size) {
+        tail_ |= static_cast<uint64_t>(static_cast<unsigned char>(*data)) << (8 * tail_size_);
+        ++tail_size_;
+    }
+}
+/**
+ * Итоговое значение
+ */
+uint64_t IndexSnapshot::Checksum::Value() const {
+    return tail_size_ == 0 ? hash_ : Mix(hash_, tail_ ^ tail_size_);
+}
+/**
+ * Перемешать очередное 8-байтное слово
+ */
+uint64_t IndexSnapshot::Checksum::Mix(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * 0x100000001b3ull;
+    return hash ^ (hash >> 29);
+}
+/**
+ * Конструктор.
+ * Создаёт временный файл и резервирует место под заголовок
+ */
+IndexSnapshot::Writer::Writer(const std::string& path) :
+    path_(path),
+    temp_path_(path + ".tmp"s),
+    out_(temp_path_, ios::binary | ios::trunc) {
+    if(!out_) {
+        throw runtime_error(ERROR_SNAPSHOT_IO + " '"s + temp_path_ + "'"s);
+    }
+    const Header empty_header = {};
+    out_.write(reinterpret_cast<const char*>(&empty_header), sizeof(empty_header));
+    offset_ = sizeof(empty_header);
+}
+/**
+ * Деструктор: незавершённый временный файл удаляется
+ */
+IndexSnapshot::Writer::~Writer() {
+    if(!finished_) {
+        out_.close();
+        remove(temp_path_.c_str());
+    }
+}
+/**
+ * Дописать заголовок с размером файла и контрольной суммой
+ * и заменить файл снимка временным
+ * Переименование атомарно: файл снимка всегда либо прежний, либо новый целиком,
+ * а отображения прежнего файла держат его содержимое до своего закрытия
+ */
+void IndexSnapshot::Writer::Finish(Header header) {
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.file_size = offset_;
+    header.checksum = checksum_.Value();
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.flush();
+    if(!out_) {
+        throw runtime_error(ERROR_SNAPSHOT_IO + " '"s + temp_path_ + "'"s);
+    }
+    out_.close();
+    if(!out_ || rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        throw runtime_error(ERROR_SNAPSHOT_IO + " '"s + path_ + "'"s);
+    }
+    finished_ = true;
+}
+/**
+ * Записать фрагмент данных
+ */
+void IndexSnapshot::Writer::Write(const char* data, size_t size) {
+    out_.write(data, size);
+    checksum_.Update(data, size);
+    offset_ += size;
+}
+/**
+ * Дополнить файл нулями до границы 8 байт
+ */
+void IndexSnapshot::Writer::Align() {
+    static const char zeros[sizeof(uint64_t)] = {};
+    const size_t remainder = offset_ % sizeof(uint64_t);
+    if(remainder != 0) {
+        Write(zeros, sizeof(uint64_t) - remainder);
+    }
+}
+/**
+ * Конструктор.
+ * Проверяет заголовок и границы разделов, не читая их содержимое
+ * Контрольная сумма проверяется отдельно: она требует прочесть весь файл
+ */
+IndexSnapshot::IndexSnapshot(const MappedFile& file) :
+    file_(file),
+    header_(At<Header>(0)) {
+    if(file_.size() < sizeof(Header) ||
+       memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+       header_->version != VERSION ||
+       header_->byte_order != BYTE_ORDER_MARK ||
+       header_->file_size != file_.size()) {
+        throw invalid_argument(ERROR_SNAPSHOT_FORMAT);
+    }
+    CheckStrings(header_->stop_words_offset, header_->stop_word_count);
+    CheckStrings(header_->terms_offset, header_->term_count);
+    CheckSection(header_->term_entries_offset, header_->term_count, sizeof(TermEntry));
+    CheckSection(header_->blocks_offset, header_->block_count, sizeof(PostingList::Block));
+    CheckSection(header_->block_data_offset, header_->block_data_size, sizeof(uint32_t));
+    CheckSection(header_->documents_offset, header_->document_count, sizeof(DocumentEntry));
+    CheckSection(header_->document_terms_offset, header_->document_term_count, sizeof(DocumentTermEntry));
+}
+/**
+ * Проверить контрольную сумму всего файла
+ */
+void IndexSnapshot::VerifyChecksum() const {
+    Checksum checksum;
+    checksum.Update(file_.data() + sizeof(Header), file_.size() - sizeof(Header));
+    if(checksum.Value() != header_->checksum) {
+        throw invalid_argument(ERROR_SNAPSHOT_CHECKSUM);
+    }
+}
+/**
+ * Строка таблицы строк по номеру
+ */
+std::string_view IndexSnapshot::String(uint64_t table_offset, uint64_t count, size_t index) const {
+    const uint64_t* offsets = At<uint64_t>(table_offset);
+    const char* chars = At<char>(table_offset + (count + 1) * sizeof(uint64_t));
+    return {chars + offsets[index], offsets[index + 1] - offsets[index]};
+}
+/**
+ * Проверить, что раздел из count элементов размера item_size лежит в файле
+ * Возвращает смещение конца раздела
+ */
+uint64_t IndexSnapshot::CheckSection(uint64_t offset, uint64_t count, uint64_t item_size) const {
+    const uint64_t size = file_.size();
+    if(offset % sizeof(uint64_t) != 0 || offset > size || count > (size - offset) / item_size) {
+        throw invalid_argument(ERROR_SNAPSHOT_FORMAT);
+    }
+    return offset + count * item_size;
+}
+/**
+ * Проверить таблицу строк
+ */
+void IndexSnapshot::CheckStrings(uint64_t offset, uint64_t count) const {
+    if(count == UINT64_MAX) {
+        throw invalid_argument(ERROR_SNAPSHOT_FORMAT);
+    }
+    const uint64_t chars_offset = CheckSection(offset, count + 1, sizeof(uint64_t));
+    const uint64_t* offsets = At<uint64_t>(offset);
+    for(uint64_t i = 0; i < count; ++i) {
+        if(offsets[i] > offsets[i + 1]) {
+            throw invalid_argument(ERROR_SNAPSHOT_FORMAT);
+        }
+    }
+    if(offsets[0] != 0 || offsets[count] > file_.size() - chars_offset) {
+        throw invalid_argument(ERROR_SNAPSHOT_FORMAT);
+    }
+}
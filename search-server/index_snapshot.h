@@ -0,0 +1,401 @@
+#pragma once
+#include "posting_list.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+/**
+ * Файл, отображённый в память только для чтения
+ */
+class MappedFile {
+public:
+    /**
+     * Конструктор.
+     * Отображает файл в память целиком
+     */
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    /**
+     * Начало отображённого файла
+     */
+    const char* data() const noexcept {
+        return data_;
+    }
+    /**
+     * Размер файла
+     */
+    size_t size() const noexcept {
+        return size_;
+    }
+private:
+    /**
+     * Начало отображённого файла
+     */
+    const char* data_ = nullptr;
+    /**
+     * Размер файла
+     */
+    size_t size_ = 0;
+};
+/**
+ * Бинарный снимок индекса поискового сервера.
+ * Все разделы файла выровнены на 8 байт и читаются прямо из отображения
+ */
+class IndexSnapshot {
+public:
+    /**
+     * Описание ошибки - не удалось открыть или записать файл снимка
+     */
+    static const char* ERROR_SNAPSHOT_IO;
+    /**
+     * Описание ошибки - файл не является снимком поддерживаемой версии
+     */
+    static const char* ERROR_SNAPSHOT_FORMAT;
+    /**
+     * Описание ошибки - контрольная сумма снимка не совпадает
+     */
+    static const char* ERROR_SNAPSHOT_CHECKSUM;
+    /**
+     * Сигнатура файла снимка
+     */
+    static constexpr char MAGIC[8] = {'S', 'R', 'C', 'H', 'I', 'D', 'X', '\0'};
+    /**
+     * Версия формата снимка
+     */
+    static const uint32_t VERSION = 3;
+    /**
+     * Метка порядка байт машины, записавшей снимок
+     */
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    /**
+     * Заголовок снимка
+     */
+    struct Header {
+        /**
+         * Сигнатура
+         */
+        char magic[8];
+        /**
+         * Версия формата
+         */
+        uint32_t version;
+        /**
+         * Метка порядка байт
+         */
+        uint32_t byte_order;
+        /**
+         * Полный размер файла
+         */
+        uint64_t file_size;
+        /**
+         * Контрольная сумма всего, что следует за заголовком
+         */
+        uint64_t checksum;
+        /**
+         * Количество стоп-слов и смещение их таблицы строк
+         */
+        uint64_t stop_word_count;
+        uint64_t stop_words_offset;
+        /**
+         * Количество слов словаря, смещения таблицы строк и описаний слов
+         */
+        uint64_t term_count;
+        uint64_t terms_offset;
+        uint64_t term_entries_offset;
+        /**
+         * Общее количество сжатых блоков вхождений и смещение их описаний
+         */
+        uint64_t block_count;
+        uint64_t blocks_offset;
+        /**
+         * Общий размер данных блоков в 32-битных словах и их смещение
+         */
+        uint64_t block_data_size;
+        uint64_t block_data_offset;
+        /**
+         * Количество документов и смещение их описаний
+         */
+        uint64_t document_count;
+        uint64_t documents_offset;
+        /**
+         * Общее количество слов прямого индекса и их смещение
+         */
+        uint64_t document_term_count;
+        uint64_t document_terms_offset;
+    };
+    /**
+     * Описание слова словаря
+     */
+    struct TermEntry {
+        /**
+         * Первый блок списка вхождений и количество его блоков
+         */
+        uint64_t blocks_begin;
+        uint64_t block_count;
+        /**
+         * Начало данных блоков списка в общих данных
+         */
+        uint64_t block_data_begin;
+        /**
+         * Длина списка вхождений
+         */
+        uint64_t postings_size;
+        /**
+         * Наибольшая text frequency слова
+         */
+        double max_frequency;
+    };
+    /**
+     * Описание документа по внутреннему номеру
+     */
+    struct DocumentEntry {
+        int32_t id;
+        int32_t rating;
+        int32_t status;
+        /**
+         * Количество слов документа в прямом индексе
+         */
+        uint32_t term_count;
+        /**
+         * Первое слово документа в общем массиве слов прямого индекса
+         */
+        uint64_t terms_begin;
+    };
+    /**
+     * Слово документа в прямом индексе
+     * Раскладка совпадает с IndexSegment::DocumentTerm, поэтому
+     * слова документа читаются прямо из отображения
+     */
+    struct DocumentTermEntry {
+        /**
+         * Номер слова в словаре снимка
+         */
+        uint32_t term;
+        uint32_t reserved;
+        /**
+         * Text frequency слова в документе
+         */
+        double tf;
+    };
+    /**
+     * Потоковый расчёт контрольной суммы
+     */
+    class Checksum {
+    public:
+        /**
+         * Учесть очередной фрагмент данных
+         */
+        void Update(const char* data, size_t size);
+        /**
+         * Итоговое значение
+         */
+        uint64_t Value() const;
+    private:
+        /**
+         * Перемешать очередное 8-байтное слово
+         */
+        static uint64_t Mix(uint64_t hash, uint64_t word);
+        /**
+         * Текущее значение
+         */
+        uint64_t hash_ = 0xcbf29ce484222325ull;
+        /**
+         * Неполное 8-байтное слово в конце данных
+         */
+        uint64_t tail_ = 0;
+        /**
+         * Количество байт в неполном слове
+         */
+        size_t tail_size_ = 0;
+    };
+    /**
+     * Запись снимка в файл.
+     * Разделы пишутся последовательно во временный файл, заголовок - в конце,
+     * затем временный файл заменяет файл снимка.
+     * Поэтому снимок можно сохранить поверх файла, отображённого в память:
+     * старое отображение продолжает ссылаться на прежнее содержимое
+     */
+    class Writer {
+    public:
+        /**
+         * Конструктор.
+         * Создаёт временный файл и резервирует место под заголовок
+         */
+        explicit Writer(const std::string& path);
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+        /**
+         * Деструктор: незавершённый временный файл удаляется
+         */
+        ~Writer();
+        /**
+         * Текущее смещение от начала файла
+         */
+        uint64_t Offset() const noexcept {
+            return offset_;
+        }
+        /**
+         * Записать массив и выровнять файл на 8 байт
+         * Возвращает смещение начала массива
+         */
+        template <typename T>
+        uint64_t WriteArray(const std::vector<T>& values) {
+            const uint64_t offset = offset_;
+            Write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+            Align();
+            return offset;
+        }
+        /**
+         * Записать таблицу строк и выровнять файл на 8 байт
+         * Возвращает смещение начала таблицы
+         */
+        template <typename StringContainer>
+        uint64_t WriteStrings(const StringContainer& strings);
+        /**
+         * Дописать заголовок с размером файла и контрольной суммой
+         * и заменить файл снимка временным
+         */
+        void Finish(Header header);
+    private:
+        /**
+         * Записать фрагмент данных
+         */
+        void Write(const char* data, size_t size);
+        /**
+         * Дополнить файл нулями до границы 8 байт
+         */
+        void Align();
+        /**
+         * Путь файла снимка
+         */
+        std::string path_;
+        /**
+         * Путь временного файла
+         */
+        std::string temp_path_;
+        /**
+         * Временный файл снимка
+         */
+        std::ofstream out_;
+        /**
+         * Временный файл записан и заменил файл снимка
+         */
+        bool finished_ = false;
+        /**
+         * Текущее смещение от начала файла
+         */
+        uint64_t offset_ = 0;
+        /**
+         * Контрольная сумма записанных разделов
+         */
+        Checksum checksum_;
+    };
+    /**
+     * Конструктор.
+     * Проверяет заголовок и границы разделов, не читая их содержимое
+     */
+    explicit IndexSnapshot(const MappedFile& file);
+    /**
+     * Проверить контрольную сумму всего файла
+     */
+    void VerifyChecksum() const;
+    /**
+     * Заголовок снимка
+     */
+    const Header& GetHeader() const noexcept {
+        return *header_;
+    }
+    /**
+     * Стоп-слово по номеру
+     */
+    std::string_view StopWord(size_t index) const {
+        return String(header_->stop_words_offset, header_->stop_word_count, index);
+    }
+    /**
+     * Слово словаря по номеру
+     */
+    std::string_view Term(size_t index) const {
+        return String(header_->terms_offset, header_->term_count, index);
+    }
+    /**
+     * Описание слова словаря по номеру
+     */
+    const TermEntry& GetTermEntry(size_t index) const {
+        return At<TermEntry>(header_->term_entries_offset)[index];
+    }
+    /**
+     * Описания сжатых блоков всех списков вхождений
+     */
+    const PostingList::Block* Blocks() const {
+        return At<PostingList::Block>(header_->blocks_offset);
+    }
+    /**
+     * Данные сжатых блоков всех списков вхождений
+     */
+    const uint32_t* BlockData() const {
+        return At<uint32_t>(header_->block_data_offset);
+    }
+    /**
+     * Описание документа по внутреннему номеру
+     */
+    const DocumentEntry& GetDocumentEntry(size_t ordinal) const {
+        return At<DocumentEntry>(header_->documents_offset)[ordinal];
+    }
+    /**
+     * Слова прямого индекса всех документов
+     */
+    const DocumentTermEntry* DocumentTerms() const {
+        return At<DocumentTermEntry>(header_->document_terms_offset);
+    }
+private:
+    /**
+     * Данные по смещению от начала файла
+     */
+    template <typename T>
+    const T* At(uint64_t offset) const {
+        return reinterpret_cast<const T*>(file_.data() + offset);
+    }
+    /**
+     * Строка таблицы строк по номеру
+     */
+    std::string_view String(uint64_t table_offset, uint64_t count, size_t index) const;
+    /**
+     * Проверить, что раздел из count элементов размера item_size лежит в файле
+     * Возвращает смещение конца раздела
+     */
+    uint64_t CheckSection(uint64_t offset, uint64_t count, uint64_t item_size) const;
+    /**
+     * Проверить таблицу строк
+     */
+    void CheckStrings(uint64_t offset, uint64_t count) const;
+    /**
+     * Отображённый файл снимка
+     */
+    const MappedFile& file_;
+    /**
+     * Заголовок снимка
+     */
+    const Header* header_;
+};
+/**
+ * Записать таблицу строк и выровнять файл на 8 байт
+ * Таблица - смещения count + 1 строк от конца смещений, затем символы
+ */
+template <typename StringContainer>
+uint64_t IndexSnapshot::Writer::WriteStrings(const StringContainer& strings) {
+    std::vector<uint64_t> offsets = {0};
+    offsets.reserve(strings.size() + 1);
+    for(const auto& str : strings) {
+        offsets.push_back(offsets.back() + str.size());
+    }
+    const uint64_t offset = WriteArray(offsets);
+    for(const auto& str : strings) {
+        Write(str.data(), str.size());
+    }
+    Align();
+    return offset;
+}
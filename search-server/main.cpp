@@ -1,71 +1,538 @@
 #include "search_server.h"
+#include "generators.h"
+#include "process_queries.h"
 #include "log_duration.h"
+#include "remove_duplicates.h"
+#include "paginator.h"
+#include "search_paginator.h"
+#include "metrics.h"
+#include "async_search.h"
+#include "allocation_counter.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <execution>
+#include <filesystem>
+#include <future>
 #include <iostream>
 #include <random>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 using namespace std;
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution('a', 'z')(generator));
-    }
-    return word;
-}
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
-    }
-    words.erase(unique(words.begin(), words.end()), words.end());
+template <typename ExecutionPolicy>
+void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+void TestProcessQueries(const SearchServer& search_server, const vector<string>& queries) {
+    {
+        LOG_DURATION("ProcessQueries"s);
+        double total_relevance = 0;
+        for (const auto& document : ProcessQueriesJoined(search_server, queries)) {
+            total_relevance += document.relevance;
+        }
+        cout << total_relevance << endl;
+    }
+    const Executor executor;
+    LOG_DURATION("ProcessQueries executor"s);
+    double total_relevance = 0;
+    for (const auto& document : ProcessQueriesJoined(executor, search_server, queries)) {
+        total_relevance += document.relevance;
+    }
+    cout << total_relevance << endl;
+}
+void TestSnapshot(const SearchServer& search_server, const vector<string>& queries) {
+    const string path = filesystem::temp_directory_path() / "search_server.snapshot";
+    {
+        LOG_DURATION("SaveSnapshot"s);
+        search_server.SaveSnapshot(path);
+    }
+    {
+        LOG_DURATION("VerifySnapshot"s);
+        SearchServer::VerifySnapshot(path);
+    }
+    {
+        LOG_DURATION("OpenSnapshot"s);
+        const SearchServer snapshot_server = SearchServer::OpenSnapshot(path);
+        double total_relevance = 0;
+        for (const string_view query : queries) {
+            for (const auto& document : snapshot_server.FindTopDocuments(query)) {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << endl;
+    }
+    filesystem::remove(path);
+}
+vector<string_view> SplitIntoWordsFind(string_view text) {
+    vector<string_view> words;
+    text.remove_prefix(min(text.find_first_not_of(' '), text.size()));
+    while (!text.empty()) {
+        const auto space = text.find(' ');
+        words.push_back(text.substr(0, space));
+        text.remove_prefix(min(text.find_first_not_of(' ', space), text.size()));
+    }
     return words;
 }
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
+void TestTokenizer(const vector<string>& documents) {
+    // разбор с проверкой символов: прежние два прохода с поиском пробелов против одного прохода блоками
+    const int repeats = 20;
+    size_t bytes = 0;
+    for (const string& document : documents) {
+        bytes += document.size();
+    }
+    const auto report = [&](string_view mark, auto split) {
+        size_t word_count = 0;
+        const auto start = chrono::steady_clock::now();
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            for (const string& document : documents) {
+                word_count += split(document);
+            }
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << mark << ": "s << bytes * repeats / seconds / (1024 * 1024) << " MB/sec, "s << word_count << " words"s << endl;
+    };
+    report("Tokenize find"s, [](string_view text) {
+        return StringProcessing::IsValidWord(text) ? SplitIntoWordsFind(text).size() : 0;
+    });
+    vector<StringProcessing::WordSpan> spans;
+    report("Tokenize SIMD"s, [&spans](string_view text) {
+        return StringProcessing::SplitIntoWordSpans(text, spans) ? spans.size() : 0;
+    });
+}
+void TestRemoveDuplicates(mt19937& generator, const vector<string>& dictionary, const vector<string>& documents) {
+    // к документам добавляются дубликаты с переставленными словами и почти дубликаты с тремя заменёнными словами
+    vector<string> texts = documents;
+    const auto split = [](const string& text) {
+        vector<string> words;
+        istringstream stream(text);
+        for (string word; stream >> word;) {
+            words.push_back(word);
+        }
+        return words;
+    };
+    const auto join = [](const vector<string>& words) {
+        string text;
+        for (const string& word : words) {
+            text += (text.empty() ? ""s : " "s) + word;
+        }
+        return text;
+    };
+    for (int i = 0; i < 2000; ++i) {
+        vector<string> words = split(documents[uniform_int_distribution<size_t>(0, documents.size() - 1)(generator)]);
+        if (i % 2 == 0) {
+            shuffle(words.begin(), words.end(), generator);
+        } else {
+            for (int j = 0; j < 3; ++j) {
+                words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] =
+                    dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)];
+            }
+        }
+        texts.push_back(join(words));
+    }
+    vector<SearchServer::NewDocument> batch;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        batch.push_back({static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    const auto report = [&](string_view mark, auto remove) {
+        SearchServer search_server(dictionary[0]);
+        search_server.AddDocuments(batch);
+        // сообщения о найденных дубликатах подсчитываются, а не выводятся
+        ostringstream found;
+        streambuf* const output = cout.rdbuf(found.rdbuf());
+        const auto start = chrono::steady_clock::now();
+        remove(search_server);
+        const auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        cout.rdbuf(output);
+        const string messages = found.str();
+        cout << mark << ": "s << duration.count() << " ms, "s << count(messages.begin(), messages.end(), '\n') << " found, "s
+             << search_server.GetDocumentCount() << " left"s << endl;
+    };
+    report("RemoveDuplicates set"s, [](SearchServer& search_server) {
+        // прежний поиск: множество отсортированных наборов слов, удаление по одному
+        set<vector<string_view>> words_known;
+        set<int> ids_duplicate;
+        for (const int document_id : search_server) {
+            const auto words_doc = search_server.GetUniqueWords(document_id);
+            if (!words_known.insert(words_doc).second) {
+                ids_duplicate.insert(document_id);
+            }
+        }
+        for (const int document_id : ids_duplicate) {
+            cout << "Found duplicate document id "s << document_id << endl;
+            search_server.RemoveDocument(document_id);
         }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
+    });
+    report("RemoveDuplicates"s, [](SearchServer& search_server) {
+        RemoveDuplicates(search_server);
+    });
+    report("RemoveNearDuplicates 0.8"s, [](SearchServer& search_server) {
+        RemoveNearDuplicates(search_server, 0.8);
+    });
+}
+void TestRemoveDocuments(const string& stop_words, const vector<string>& documents, const vector<string>& queries) {
+    // удаляется каждый четвёртый документ: по одному и одним пакетом
+    vector<SearchServer::NewDocument> batch;
+    vector<int> removed;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        if (i % 4 == 0) {
+            removed.push_back(static_cast<int>(i));
         }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
     }
-    return query;
+    const auto report = [&](string_view mark, auto remove) {
+        SearchServer search_server(stop_words);
+        search_server.AddDocuments(batch);
+        const auto start = chrono::steady_clock::now();
+        remove(search_server);
+        const auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        double total_relevance = 0;
+        for (const string_view query : queries) {
+            for (const auto& document : search_server.FindTopDocuments(query)) {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << mark << ": "s << duration.count() << " ms, "s << total_relevance << endl;
+    };
+    report("RemoveDocument"s, [&removed](SearchServer& search_server) {
+        for (const int document_id : removed) {
+            search_server.RemoveDocument(document_id);
+        }
+    });
+    report("RemoveDocuments"s, [&removed](SearchServer& search_server) {
+        search_server.RemoveDocuments(removed);
+    });
 }
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+void TestPagination(const SearchServer& search_server, const vector<string>& queries) {
+    // страница 50 по 10 документов: разбиение полной выдачи, отбор 510 лучших и курсор по страницам
+    const size_t page_size = 10;
+    const size_t page = 50;
+    size_t mismatches = 0;
+    vector<vector<Document>> expected;
+    {
+        LOG_DURATION("Paginate full"s);
+        for (const string& query : queries) {
+            const auto documents = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, search_server.GetDocumentCount());
+            const auto pages = Paginate(documents, page_size);
+            auto it = pages.begin();
+            for (size_t i = 0; i < page && it != pages.end(); ++i) {
+                ++it;
+            }
+            expected.emplace_back(it == pages.end() ? vector<Document>{} : vector<Document>(it->begin(), it->end()));
+        }
     }
-    return queries;
+    const auto compare = [&mismatches](const vector<Document>& lhs, const vector<Document>& rhs) {
+        const bool equal = lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](const Document& l, const Document& r) {
+            return l.id == r.id;
+        });
+        mismatches += equal ? 0 : 1;
+    };
+    {
+        LOG_DURATION("SearchPaginator page"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            compare(SearchPaginator(search_server, queries[i], DocumentStatus::ACTUAL, page_size).GetPage(page), expected[i]);
+        }
+    }
+    // курсор проходит предыдущие страницы, замеряется получение только последней
+    chrono::steady_clock::duration cursor_duration{};
+    for (size_t i = 0; i < queries.size(); ++i) {
+        SearchPaginator paginator(search_server, queries[i], DocumentStatus::ACTUAL, page_size);
+        for (size_t j = 0; j < page; ++j) {
+            paginator.Next();
+        }
+        const auto start = chrono::steady_clock::now();
+        const vector<Document> documents = paginator.Next();
+        cursor_duration += chrono::steady_clock::now() - start;
+        compare(documents, expected[i]);
+    }
+    cout << "SearchPaginator cursor: "s << chrono::duration_cast<chrono::milliseconds>(cursor_duration).count() << " ms"s << endl;
+    cout << "Pagination mismatches: "s << mismatches << endl;
 }
 template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
+void TestBulkLoad(string_view mark, const string& stop_words, const vector<string>& documents, const vector<string>& queries, ExecutionPolicy&& policy) {
+    vector<SearchServer::NewDocument> batch;
+    batch.reserve(documents.size());
+    size_t bytes = 0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        bytes += documents[i].size();
+    }
+    SearchServer search_server(stop_words);
+    const auto start = chrono::steady_clock::now();
+    search_server.AddDocuments(policy, batch);
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << mark << ": "s << documents.size() / seconds << " docs/sec, "s
+         << bytes / seconds / (1024 * 1024) << " MB/sec"s << endl;
     double total_relevance = 0;
     for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+        for (const auto& document : search_server.FindTopDocuments(query)) {
             total_relevance += document.relevance;
         }
     }
     cout << total_relevance << endl;
 }
+void TestMixedLoad(SearchServer& search_server, mt19937& generator, const vector<string>& dictionary, const vector<string>& queries) {
+    // писатель с постоянной частотой добавляет документ и удаляет самый старый из добавленных,
+    // читатели непрерывно выполняют запросы и замеряют их задержку
+    const auto duration = 1s;
+    const auto write_interval = 1ms;
+    const int first_id = search_server.GetDocumentCount();
+    const auto documents = GenerateQueries(generator, dictionary, static_cast<int>(duration / write_interval) + 1, 70);
+    const size_t reader_count = max(2u, thread::hardware_concurrency()) - 1;
+    vector<vector<double>> latencies(reader_count);
+    atomic<bool> stop = false;
+    vector<thread> readers;
+    for (size_t reader = 0; reader < reader_count; ++reader) {
+        readers.emplace_back([&, reader]() {
+            for (size_t i = reader; !stop.load(); i = (i + 1) % queries.size()) {
+                const auto start = chrono::steady_clock::now();
+                search_server.FindTopDocuments(queries[i]);
+                latencies[reader].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+            }
+        });
+    }
+    size_t writes = 0;
+    const auto start = chrono::steady_clock::now();
+    for (auto next = start; next - start < duration; next += write_interval) {
+        this_thread::sleep_until(next);
+        search_server.AddDocument(first_id + writes, documents[writes], DocumentStatus::ACTUAL, {1, 2, 3});
+        search_server.RemoveDocument(static_cast<int>(writes));
+        ++writes;
+    }
+    stop = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    vector<double> all;
+    for (const auto& reader_latencies : latencies) {
+        all.insert(all.end(), reader_latencies.begin(), reader_latencies.end());
+    }
+    sort(all.begin(), all.end());
+    cout << "Mixed load: "s << all.size() << " reads, "s << writes << " writes, read p50 "s
+         << all[all.size() / 2] << " us, p99 "s << all[all.size() * 99 / 100] << " us"s << endl;
+}
+bool TestSharedExecutor(const SearchServer& search_server, const vector<string>& queries) {
+    // два потока делят исполнитель: один ищет по запросу, другой - пакетами запросов
+    // ожидая свои порции, поток не должен выполнять чужие и портить свой контекст запроса
+    Executor::Options options;
+    options.thread_count = 4;
+    options.sequential_threshold = 0;
+    const Executor executor(options);
+    vector<vector<Document>> expected;
+    for (const string_view query : queries) {
+        expected.push_back(search_server.FindTopDocuments(execution::seq, query));
+    }
+    const int rounds = 5;
+    atomic<size_t> results = 0;
+    atomic<size_t> mismatches = 0;
+    const auto check = [&](size_t index, const vector<Document>& documents) {
+        ++results;
+        const auto same = [](const Document& lhs, const Document& rhs) {
+            return lhs.id == rhs.id && lhs.relevance == rhs.relevance;
+        };
+        if (!equal(documents.begin(), documents.end(), expected[index].begin(), expected[index].end(), same)) {
+            ++mismatches;
+        }
+    };
+    LOG_DURATION("Shared executor"s);
+    thread single([&]() {
+        for (int round = 0; round < rounds; ++round) {
+            for (size_t index = 0; index < queries.size(); ++index) {
+                check(index, search_server.FindTopDocuments(executor, queries[index]));
+            }
+        }
+    });
+    thread batch([&]() {
+        for (int round = 0; round < rounds; ++round) {
+            const auto batch_results = search_server.FindTopDocumentsBatch(executor, queries);
+            for (size_t index = 0; index < queries.size(); ++index) {
+                check(index, batch_results[index]);
+            }
+        }
+    });
+    single.join();
+    batch.join();
+    cout << "Shared executor: "s << mismatches << " mismatches of "s << results << endl;
+    return mismatches == 0;
+}
+bool TestQueryAllocations(const SearchServer& search_server, const vector<string>& queries) {
+    // после прогрева контекст вмещает любой из запросов и выдачу
+    SearchServer::QueryContext context;
+    for (const string_view query : queries) {
+        search_server.FindTopDocuments(context, query);
+    }
+    LOG_DURATION("QueryContext"s);
+    const size_t start_count = AllocationCounter::Count();
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(context, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    const size_t allocations = AllocationCounter::Count() - start_count;
+    cout << total_relevance << endl;
+    if (!AllocationCounter::IsEnabled()) {
+        cout << "Query allocations: not counted"s << endl;
+        return true;
+    }
+    cout << "Query allocations: "s << allocations << endl;
+    return allocations == 0;
+}
+void TestQueryCache(SearchServer& search_server, mt19937& generator, const vector<string>& queries) {
+    // популярные запросы повторяются: частота запроса убывает с его номером
+    vector<double> weights(queries.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weights[i] = 1. / (i + 1);
+    }
+    discrete_distribution<size_t> popularity(weights.begin(), weights.end());
+    vector<size_t> stream(2'000);
+    for (size_t& query : stream) {
+        query = popularity(generator);
+    }
+    const auto run = [&](string_view mark) {
+        LOG_DURATION(mark);
+        double total_relevance = 0;
+        for (const size_t query : stream) {
+            for (const auto& document : search_server.FindTopDocuments(queries[query])) {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << endl;
+    };
+    run("Query cache off"s);
+    search_server.SetQueryCache(1 << 20);
+    run("Query cache on"s);
+    // добавленный документ меняет поколение индекса - кэшированная выдача не используется
+    const int document_id = 1'000'000;
+    search_server.AddDocument(document_id, queries[0], DocumentStatus::ACTUAL, {100});
+    const auto cached = search_server.FindTopDocuments(queries[0]);
+    const auto stats = search_server.GetQueryCacheStats();
+    search_server.SetQueryCache(0);
+    const auto fresh = search_server.FindTopDocuments(queries[0]);
+    const bool consistent = !cached.empty() && cached.front().id == document_id && cached.size() == fresh.size() &&
+        equal(cached.begin(), cached.end(), fresh.begin(), [](const Document& lhs, const Document& rhs) {
+            return lhs.id == rhs.id && lhs.relevance == rhs.relevance;
+        });
+    search_server.RemoveDocument(document_id);
+    cout << "Query cache: "s << stats.hits << " hits, "s << stats.misses << " misses, "s
+         << stats.evictions << " evictions, "s << stats.rejections << " rejections, "s
+         << stats.entries << " entries, "s << stats.bytes << " bytes, "s
+         << (consistent ? "consistent"s : "STALE"s) << endl;
+}
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+void TestAsyncSearch(const SearchServer& search_server, const vector<string>& queries) {
+    {
+        AsyncSearch async_search(search_server);
+        LOG_DURATION("FindTopDocumentsAsync"s);
+        vector<future<vector<Document>>> results;
+        results.reserve(queries.size());
+        for (const string& query : queries) {
+            results.push_back(async_search.FindTopDocumentsAsync(query));
+        }
+        double total_relevance = 0;
+        for (auto& result : results) {
+            for (const Document& document : result.get()) {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << total_relevance << endl;
+    }
+    // один поток и короткая очередь: лишние запросы отклоняются,
+    // отменённые и просроченные снимаются без результата
+    AsyncSearch::Options options;
+    options.thread_count = 1;
+    options.queue_capacity = 8;
+    AsyncSearch async_search(search_server, options);
+    AsyncSearch::RequestOptions cancelled;
+    AsyncSearch::RequestOptions expired;
+    expired.deadline = AsyncSearch::Clock::now();
+    atomic<size_t> completed = 0;
+    atomic<size_t> abandoned = 0;
+    size_t rejected = 0;
+    const auto callback = [&](vector<Document>, exception_ptr error) {
+        if (!error) {
+            ++completed;
+            return;
+        }
+        try {
+            rethrow_exception(error);
+        } catch (const AsyncSearch::Abandoned&) {
+            ++abandoned;
+        } catch (...) {
+        }
+    };
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const AsyncSearch::RequestOptions& request = i % 3 == 1 ? cancelled : i % 3 == 2 ? expired : AsyncSearch::RequestOptions{};
+        try {
+            async_search.FindTopDocumentsAsync(queries[i], request, callback);
+        } catch (const overflow_error&) {
+            ++rejected;
+        }
+        if (i == 0) {
+            cancelled.cancellation.Cancel();
+        }
+    }
+    while (completed + abandoned + rejected < queries.size()) {
+        this_thread::yield();
+    }
+    cout << "Async: "s << completed << " completed, "s << abandoned << " abandoned, "s << rejected << " rejected"s << endl;
+}
+void TestMetrics(const SearchServer& search_server, const vector<string>& queries) {
+#ifdef SEARCH_SERVER_METRICS
+    Metrics::Instance().Reset();
+    SearchServer::QueryContext context;
+    for (const string_view query : queries) {
+        search_server.FindTopDocuments(context, query);
+    }
+    const Metrics::Snapshot snapshot = Metrics::Instance().TakeSnapshot();
+    cout << snapshot.ToText();
+    cout << snapshot.ToJson() << endl;
+#else
+    (void)search_server;
+    (void)queries;
+    cout << "Metrics disabled"s << endl;
+#endif
+}
 int main() {
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
     SearchServer search_server(dictionary[0]);
-    for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    {
+        LOG_DURATION("AddDocument"s);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
     }
+    cout << "Postings memory: "s << search_server.GetPostingsMemoryUsage() << " bytes"s << endl;
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
+    TestTokenizer(documents);
+    TestBulkLoad("AddDocuments seq"s, dictionary[0], documents, queries, execution::seq);
+    TestBulkLoad("AddDocuments par"s, dictionary[0], documents, queries, execution::par);
     TEST(seq);
     TEST(par);
+    const Executor executor;
+    Test("executor"s, search_server, queries, executor);
+    TestPagination(search_server, queries);
+    const bool allocation_free = TestQueryAllocations(search_server, queries);
+    TestMetrics(search_server, queries);
+    TestAsyncSearch(search_server, queries);
+    TestProcessQueries(search_server, queries);
+    const bool executor_isolated = TestSharedExecutor(search_server, queries);
+    TestSnapshot(search_server, queries);
+    TestRemoveDuplicates(generator, dictionary, documents);
+    TestRemoveDocuments(dictionary[0], documents, queries);
+    TestQueryCache(search_server, generator, queries);
+    TestMixedLoad(search_server, generator, dictionary, queries);
+    return allocation_free && executor_isolated ? EXIT_SUCCESS : EXIT_FAILURE;
 }
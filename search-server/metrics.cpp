@@ -0,0 +1,233 @@
+#include "metrics.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+/**
+ * Описание ошибки - зарегистрировано слишком много метрик
+ */
+const char* Metrics::ERROR_METRICS_LIMIT = "Зарегистрировано слишком много метрик";
+/**
+ * Значение процентиля percentile (от 0 до 100): середина его корзины
+ * Наибольшее значение известно точно и ограничивает результат
+ */
+uint64_t Metrics::Histogram::Percentile(double percentile) const {
+    if(count_ == 0) return 0;
+    const auto rank = static_cast<uint64_t>(percentile / 100 * count_);
+    uint64_t seen = 0;
+    for(size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += buckets_[bucket];
+        if(seen > rank) {
+            if(bucket + 1 == BUCKET_COUNT) return max_;
+            const uint64_t lower = BucketLowerBound(bucket);
+            const uint64_t upper = BucketLowerBound(bucket + 1);
+            return min(max_, lower + (upper - lower) / 2);
+        }
+    }
+    return max_;
+}
+/**
+ * Снимок текстом: строка на метрику
+ */
+std::string Metrics::Snapshot::ToText() const {
+    ostringstream out;
+    for(const auto& [name, value] : counters) {
+        out << name << ": "s << value << '\n';
+    }
+    for(const auto& [name, histogram] : histograms) {
+        out << name << ": count "s << histogram.Count()
+            << ", mean "s << static_cast<uint64_t>(histogram.Mean()) << " ns"s
+            << ", p50 "s << histogram.Percentile(50) << " ns"s
+            << ", p99 "s << histogram.Percentile(99) << " ns"s
+            << ", p999 "s << histogram.Percentile(99.9) << " ns"s
+            << ", max "s << histogram.Max() << " ns"s << '\n';
+    }
+    return out.str();
+}
+/**
+ * Снимок в формате JSON
+ * Имена метрик не экранируются - они задаются в коде и не содержат кавычек
+ */
+std::string Metrics::Snapshot::ToJson() const {
+    ostringstream out;
+    out << "{\"counters\":{"s;
+    for(size_t i = 0; i < counters.size(); ++i) {
+        out << (i > 0 ? ","s : ""s) << '"' << counters[i].first << "\":"s << counters[i].second;
+    }
+    out << "},\"histograms\":{"s;
+    for(size_t i = 0; i < histograms.size(); ++i) {
+        const Histogram& histogram = histograms[i].second;
+        out << (i > 0 ? ","s : ""s) << '"' << histograms[i].first << "\":{"s
+            << "\"count\":"s << histogram.Count()
+            << ",\"mean_ns\":"s << static_cast<uint64_t>(histogram.Mean())
+            << ",\"p50_ns\":"s << histogram.Percentile(50)
+            << ",\"p99_ns\":"s << histogram.Percentile(99)
+            << ",\"p999_ns\":"s << histogram.Percentile(99.9)
+            << ",\"max_ns\":"s << histogram.Max() << '}';
+    }
+    out << "}}"s;
+    return out.str();
+}
+/**
+ * Общий реестр метрик процесса
+ */
+Metrics& Metrics::Instance() {
+    static Metrics metrics;
+    return metrics;
+}
+/**
+ * Номер гистограммы с именем name, регистрируется при первом обращении
+ */
+size_t Metrics::RegisterHistogram(std::string_view name) {
+    return Register(histogram_names_, name, MAX_HISTOGRAMS);
+}
+/**
+ * Номер счётчика с именем name, регистрируется при первом обращении
+ */
+size_t Metrics::RegisterCounter(std::string_view name) {
+    return Register(counter_names_, name, MAX_COUNTERS);
+}
+/**
+ * Снимок метрик всех потоков
+ * Запись, идущая одновременно со снимком, может попасть в него частично
+ */
+Metrics::Snapshot Metrics::TakeSnapshot() const {
+    lock_guard lock(mutex_);
+    Snapshot snapshot;
+    for(const string& name : counter_names_) {
+        snapshot.counters.emplace_back(name, 0);
+    }
+    for(const string& name : histogram_names_) {
+        snapshot.histograms.emplace_back(name, Histogram());
+    }
+    const auto add_block = [this, &snapshot](const ThreadBlock& block) {
+        for(size_t i = 0; i < counter_names_.size(); ++i) {
+            snapshot.counters[i].second += block.counters[i].load(memory_order_relaxed);
+        }
+        for(size_t i = 0; i < histogram_names_.size(); ++i) {
+            const HistogramCounters& counters = block.histograms[i];
+            Histogram& histogram = snapshot.histograms[i].second;
+            for(size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+                histogram.buckets_[bucket] += counters.buckets[bucket].load(memory_order_relaxed);
+            }
+            histogram.count_ += counters.count.load(memory_order_relaxed);
+            histogram.sum_ += counters.sum.load(memory_order_relaxed);
+            histogram.max_ = max(histogram.max_, counters.max.load(memory_order_relaxed));
+        }
+    };
+    for(const auto& block : blocks_) {
+        add_block(*block);
+    }
+    add_block(*retired_);
+    return snapshot;
+}
+/**
+ * Обнулить метрики всех потоков
+ * Запись, идущая одновременно с обнулением, может быть потеряна
+ */
+void Metrics::Reset() {
+    lock_guard lock(mutex_);
+    for(const auto& block : blocks_) {
+        Clear(*block);
+    }
+    Clear(*retired_);
+}
+/**
+ * Наименьшее значение корзины
+ */
+uint64_t Metrics::BucketLowerBound(size_t bucket) noexcept {
+    if(bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    const size_t shift = bucket / SUB_BUCKETS - 1;
+    return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
+/**
+ * Выдать блок метрик новому потоку: свободный или новый
+ * Поэтому память блоков ограничена наибольшим числом одновременно
+ * пишущих потоков, а не числом когда-либо созданных
+ */
+Metrics::ThreadBlock& Metrics::AcquireBlock() {
+    {
+        lock_guard lock(mutex_);
+        if(!free_blocks_.empty()) {
+            blocks_.push_back(move(free_blocks_.back()));
+            free_blocks_.pop_back();
+            return *blocks_.back();
+        }
+    }
+    auto block = make_unique<ThreadBlock>();
+    lock_guard lock(mutex_);
+    blocks_.push_back(move(block));
+    // место в списке свободных резервируется заранее: возврат блока не выделяет память
+    free_blocks_.reserve(blocks_.size() + free_blocks_.size());
+    return *blocks_.back();
+}
+/**
+ * Вернуть блок завершившегося потока: его записи прибавляются
+ * к записям завершившихся потоков, обнулённый блок становится свободным
+ * Поток больше не пишет в блок, поэтому перенос под блокировкой не теряет записей
+ */
+void Metrics::ReleaseBlock(ThreadBlock& block) noexcept {
+    lock_guard lock(mutex_);
+    const auto it = find_if(blocks_.begin(), blocks_.end(), [&block](const auto& owned) {
+        return owned.get() == &block;
+    });
+    if(it == blocks_.end()) return;
+    Accumulate(block, *retired_);
+    Clear(block);
+    free_blocks_.push_back(move(*it));
+    *it = move(blocks_.back());
+    blocks_.pop_back();
+}
+/**
+ * Прибавить записи блока from к блоку to
+ */
+void Metrics::Accumulate(const ThreadBlock& from, ThreadBlock& to) noexcept {
+    for(size_t i = 0; i < MAX_COUNTERS; ++i) {
+        Increment(to.counters[i], from.counters[i].load(memory_order_relaxed));
+    }
+    for(size_t i = 0; i < MAX_HISTOGRAMS; ++i) {
+        const HistogramCounters& source = from.histograms[i];
+        HistogramCounters& target = to.histograms[i];
+        for(size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            Increment(target.buckets[bucket], source.buckets[bucket].load(memory_order_relaxed));
+        }
+        Increment(target.count, source.count.load(memory_order_relaxed));
+        Increment(target.sum, source.sum.load(memory_order_relaxed));
+        target.max.store(max(target.max.load(memory_order_relaxed), source.max.load(memory_order_relaxed)),
+                         memory_order_relaxed);
+    }
+}
+/**
+ * Обнулить записи блока
+ */
+void Metrics::Clear(ThreadBlock& block) noexcept {
+    for(auto& counter : block.counters) {
+        counter.store(0, memory_order_relaxed);
+    }
+    for(HistogramCounters& counters : block.histograms) {
+        for(auto& bucket : counters.buckets) {
+            bucket.store(0, memory_order_relaxed);
+        }
+        counters.count.store(0, memory_order_relaxed);
+        counters.sum.store(0, memory_order_relaxed);
+        counters.max.store(0, memory_order_relaxed);
+    }
+}
+/**
+ * Номер метрики с именем name в списке names, регистрируется при первом обращении
+ */
+size_t Metrics::Register(std::vector<std::string>& names, std::string_view name, size_t limit) {
+    lock_guard lock(mutex_);
+    const auto it = find(names.begin(), names.end(), name);
+    if(it != names.end()) {
+        return static_cast<size_t>(it - names.begin());
+    }
+    if(names.size() >= limit) {
+        throw length_error(ERROR_METRICS_LIMIT);
+    }
+    names.push_back(string(name));
+    return names.size() - 1;
+}
@@ -0,0 +1,324 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+/**
+ * Метрики горячего пути: счётчики и гистограммы задержек.
+ * Метрики регистрируются по имени и получают номер, запись идёт по номеру.
+ * Каждый поток пишет в собственный блок счётчиков без блокировок и
+ * атомарных операций чтения-записи, снимок складывает блоки всех потоков.
+ * Гистограмма хранит задержки в наносекундах логарифмическими корзинами,
+ * каждая степень двойки делится на SUB_BUCKETS равных частей (как в HDR Histogram),
+ * поэтому относительная погрешность процентилей не больше 1 / SUB_BUCKETS
+ */
+class Metrics {
+public:
+    /**
+     * Наибольшее количество гистограмм
+     */
+    static constexpr size_t MAX_HISTOGRAMS = 16;
+    /**
+     * Наибольшее количество счётчиков
+     */
+    static constexpr size_t MAX_COUNTERS = 16;
+    /**
+     * Количество разрядов номера корзины внутри степени двойки
+     */
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    /**
+     * Количество корзин на степень двойки
+     */
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+    /**
+     * Значения от 2^MAX_EXPONENT наносекунд (около минуты) попадают в последнюю корзину
+     */
+    static constexpr size_t MAX_EXPONENT = 36;
+    /**
+     * Количество корзин гистограммы
+     */
+    static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    /**
+     * Описание ошибки - зарегистрировано слишком много метрик
+     */
+    static const char* ERROR_METRICS_LIMIT;
+    /**
+     * Снимок гистограммы
+     */
+    class Histogram {
+    public:
+        /**
+         * Количество значений
+         */
+        uint64_t Count() const noexcept {
+            return count_;
+        }
+        /**
+         * Среднее значение
+         */
+        double Mean() const noexcept {
+            return count_ == 0 ? 0 : static_cast<double>(sum_) / count_;
+        }
+        /**
+         * Наибольшее значение
+         */
+        uint64_t Max() const noexcept {
+            return max_;
+        }
+        /**
+         * Значение процентиля percentile (от 0 до 100): середина его корзины
+         */
+        uint64_t Percentile(double percentile) const;
+    private:
+        friend class Metrics;
+        /**
+         * Количество значений по корзинам
+         */
+        std::vector<uint64_t> buckets_ = std::vector<uint64_t>(BUCKET_COUNT);
+        /**
+         * Количество значений
+         */
+        uint64_t count_ = 0;
+        /**
+         * Сумма значений
+         */
+        uint64_t sum_ = 0;
+        /**
+         * Наибольшее значение
+         */
+        uint64_t max_ = 0;
+    };
+    /**
+     * Снимок всех метрик
+     */
+    struct Snapshot {
+        /**
+         * Счётчики по именам в порядке регистрации
+         */
+        std::vector<std::pair<std::string, uint64_t>> counters;
+        /**
+         * Гистограммы по именам в порядке регистрации
+         */
+        std::vector<std::pair<std::string, Histogram>> histograms;
+        /**
+         * Снимок текстом: строка на метрику
+         */
+        std::string ToText() const;
+        /**
+         * Снимок в формате JSON
+         */
+        std::string ToJson() const;
+    };
+    /**
+     * Общий реестр метрик процесса
+     */
+    static Metrics& Instance();
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+    /**
+     * Номер гистограммы с именем name, регистрируется при первом обращении
+     */
+    size_t RegisterHistogram(std::string_view name);
+    /**
+     * Номер счётчика с именем name, регистрируется при первом обращении
+     */
+    size_t RegisterCounter(std::string_view name);
+    /**
+     * Записать значение в гистограмму с номером histogram
+     */
+    void Record(size_t histogram, uint64_t value) noexcept {
+        auto& counters = LocalBlock().histograms[histogram];
+        Increment(counters.buckets[BucketIndex(value)], 1);
+        Increment(counters.count, 1);
+        Increment(counters.sum, value);
+        if(value > counters.max.load(std::memory_order_relaxed)) {
+            counters.max.store(value, std::memory_order_relaxed);
+        }
+    }
+    /**
+     * Прибавить value к счётчику с номером counter
+     */
+    void Add(size_t counter, uint64_t value) noexcept {
+        Increment(LocalBlock().counters[counter], value);
+    }
+    /**
+     * Снимок метрик всех потоков
+     * Запись, идущая одновременно со снимком, может попасть в него частично
+     */
+    Snapshot TakeSnapshot() const;
+    /**
+     * Обнулить метрики всех потоков
+     * Запись, идущая одновременно с обнулением, может быть потеряна
+     */
+    void Reset();
+    /**
+     * Номер корзины значения
+     */
+    static size_t BucketIndex(uint64_t value) noexcept {
+        if(value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        const size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(value));
+        if(exponent >= MAX_EXPONENT) {
+            return BUCKET_COUNT - 1;
+        }
+        const size_t shift = exponent - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + static_cast<size_t>(value >> shift) - SUB_BUCKETS;
+    }
+    /**
+     * Наименьшее значение корзины
+     */
+    static uint64_t BucketLowerBound(size_t bucket) noexcept;
+private:
+    Metrics() = default;
+    /**
+     * Счётчики гистограммы одного потока
+     */
+    struct HistogramCounters {
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+    /**
+     * Блок метрик потока
+     * Пишет в него только сам поток, снимок читает блоки всех потоков
+     */
+    struct ThreadBlock {
+        std::array<std::atomic<uint64_t>, MAX_COUNTERS> counters{};
+        std::array<HistogramCounters, MAX_HISTOGRAMS> histograms;
+    };
+    /**
+     * Увеличить счётчик своего потока
+     * Писатель у счётчика один, поэтому атомарное чтение-запись не нужно
+     */
+    static void Increment(std::atomic<uint64_t>& counter, uint64_t value) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    /**
+     * Блок метрик, закреплённый за потоком
+     * При завершении потока блок возвращается реестру
+     */
+    struct LocalBlockOwner {
+        ThreadBlock* block = nullptr;
+        ~LocalBlockOwner() {
+            if(block != nullptr) {
+                Instance().ReleaseBlock(*block);
+            }
+        }
+    };
+    /**
+     * Блок метрик текущего потока, выдаётся при первой записи
+     */
+    ThreadBlock& LocalBlock() noexcept {
+        thread_local LocalBlockOwner owner;
+        if(owner.block == nullptr) {
+            owner.block = &AcquireBlock();
+        }
+        return *owner.block;
+    }
+    /**
+     * Выдать блок метрик новому потоку: свободный или новый
+     */
+    ThreadBlock& AcquireBlock();
+    /**
+     * Вернуть блок завершившегося потока: его записи прибавляются
+     * к записям завершившихся потоков, обнулённый блок становится свободным
+     */
+    void ReleaseBlock(ThreadBlock& block) noexcept;
+    /**
+     * Прибавить записи блока from к блоку to
+     */
+    static void Accumulate(const ThreadBlock& from, ThreadBlock& to) noexcept;
+    /**
+     * Обнулить записи блока
+     */
+    static void Clear(ThreadBlock& block) noexcept;
+    /**
+     * Номер метрики с именем name в списке names, регистрируется при первом обращении
+     */
+    size_t Register(std::vector<std::string>& names, std::string_view name, size_t limit);
+    /**
+     * Блокировка регистрации метрик и списка блоков
+     */
+    mutable std::mutex mutex_;
+    /**
+     * Имена гистограмм по номерам
+     */
+    std::vector<std::string> histogram_names_;
+    /**
+     * Имена счётчиков по номерам
+     */
+    std::vector<std::string> counter_names_;
+    /**
+     * Блоки метрик работающих потоков
+     */
+    std::vector<std::unique_ptr<ThreadBlock>> blocks_;
+    /**
+     * Обнулённые блоки завершившихся потоков для новых потоков
+     */
+    std::vector<std::unique_ptr<ThreadBlock>> free_blocks_;
+    /**
+     * Записи завершившихся потоков
+     */
+    std::unique_ptr<ThreadBlock> retired_ = std::make_unique<ThreadBlock>();
+};
+/**
+ * Замер времени от создания до конца блока в гистограмму
+ */
+class ScopedTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+    explicit ScopedTimer(size_t histogram) :
+        histogram_(histogram) { }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    ~ScopedTimer() {
+        const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_);
+        Metrics::Instance().Record(histogram_, static_cast<uint64_t>(duration.count()));
+    }
+private:
+    /**
+     * Номер гистограммы
+     */
+    size_t histogram_;
+    /**
+     * Время начала замера
+     */
+    Clock::time_point start_ = Clock::now();
+};
+
+#define METRICS_CONCAT_INTERNAL(X, Y) X##Y
+#define METRICS_CONCAT(X, Y) METRICS_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_METRICS
+/**
+ * Замерить время до конца текущего блока в гистограмму с именем name
+ * Номер гистограммы находится один раз при первом выполнении
+ */
+#define METRICS_TIMER(name)                                                                            \
+    static const size_t METRICS_CONCAT(metrics_histogram_, __LINE__) =                                 \
+        Metrics::Instance().RegisterHistogram(name);                                                   \
+    const ScopedTimer METRICS_CONCAT(metrics_timer_, __LINE__)(METRICS_CONCAT(metrics_histogram_, __LINE__))
+/**
+ * Прибавить value к счётчику с именем name
+ */
+#define METRICS_ADD(name, value)                                                                       \
+    do {                                                                                               \
+        static const size_t metrics_counter = Metrics::Instance().RegisterCounter(name);               \
+        Metrics::Instance().Add(metrics_counter, (value));                                             \
+    } while(false)
+#else
+/**
+ * Метрики отключены: замеры и счётчики не компилируются
+ */
+#define METRICS_TIMER(name) do { } while(false)
+#define METRICS_ADD(name, value) do { (void)sizeof(value); } while(false)
+#endif
@@ -0,0 +1,94 @@
+#include "ordinal_table.h"
+#include <algorithm>
+
+using namespace std;
+/**
+ * Конструктор пустой таблицы, прежние таблицы передаются epochs
+ */
+OrdinalTable::OrdinalTable(EpochManager& epochs) :
+    epochs_(epochs) {
+    Rebuild();
+}
+/**
+ * Внутренний номер документа или NOT_FOUND
+ * Читатель вызывает поиск с закреплённой эпохой
+ */
+uint32_t OrdinalTable::Find(int document_id) const {
+    const Table& table = *published_.load();
+    const uint64_t slot = table.slots[Locate(table, document_id)].load(memory_order_acquire);
+    return slot == EMPTY_SLOT ? NOT_FOUND : static_cast<uint32_t>(slot);
+}
+/**
+ * Добавить документ, false - если id уже есть
+ * Удалённый id возвращается в свою прежнюю ячейку
+ */
+bool OrdinalTable::Insert(int document_id, uint32_t ordinal) {
+    atomic<uint64_t>& slot = table_->slots[Locate(*table_, document_id)];
+    const uint64_t value = slot.load(memory_order_relaxed);
+    if(value != EMPTY_SLOT && static_cast<uint32_t>(value) != NOT_FOUND) {
+        return false;
+    }
+    slot.store(MakeSlot(document_id, ordinal), memory_order_release);
+    ++size_;
+    if(value == EMPTY_SLOT && ++used_ * 2 > table_->mask + 1) {
+        Rebuild();
+    }
+    return true;
+}
+/**
+ * Удалить документ, false - если id нет
+ */
+bool OrdinalTable::Erase(int document_id) {
+    atomic<uint64_t>& slot = table_->slots[Locate(*table_, document_id)];
+    const uint64_t value = slot.load(memory_order_relaxed);
+    if(value == EMPTY_SLOT || static_cast<uint32_t>(value) == NOT_FOUND) {
+        return false;
+    }
+    slot.store(MakeSlot(document_id, NOT_FOUND), memory_order_release);
+    --size_;
+    return true;
+}
+/**
+ * Ячейка с id документа или пустая ячейка, где он должен быть
+ */
+size_t OrdinalTable::Locate(const Table& table, int document_id) {
+    const uint64_t key = static_cast<uint64_t>(document_id);
+    size_t index = Home(document_id, table.mask);
+    while(true) {
+        const uint64_t slot = table.slots[index].load(memory_order_acquire);
+        if(slot == EMPTY_SLOT || slot >> 32 == key) {
+            return index;
+        }
+        index = (index + 1) & table.mask;
+    }
+}
+/**
+ * Перестроить таблицу без удалённых id и опубликовать её
+ * Размер выбирается так, чтобы таблица после перестройки была заполнена не больше чем на четверть
+ */
+void OrdinalTable::Rebuild() {
+    size_t capacity = MIN_TABLE_SIZE;
+    while(capacity < size_ * 4) {
+        capacity *= 2;
+    }
+    auto table = make_shared<Table>();
+    table->mask = capacity - 1;
+    table->slots = make_unique<atomic<uint64_t>[]>(capacity);
+    for(size_t index = 0; index < capacity; ++index) {
+        table->slots[index].store(EMPTY_SLOT, memory_order_relaxed);
+    }
+    used_ = 0;
+    if(table_ != nullptr) {
+        for(size_t index = 0; index <= table_->mask; ++index) {
+            const uint64_t slot = table_->slots[index].load(memory_order_relaxed);
+            if(slot == EMPTY_SLOT || static_cast<uint32_t>(slot) == NOT_FOUND) continue;
+            table->slots[Locate(*table, static_cast<int>(slot >> 32))].store(slot, memory_order_relaxed);
+            ++used_;
+        }
+    }
+    published_.store(table.get());
+    if(table_ != nullptr) {
+        epochs_.Retire(move(table_));
+    }
+    table_ = move(table);
+}
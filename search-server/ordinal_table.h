@@ -0,0 +1,100 @@
+#pragma once
+#include "epoch_manager.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+/**
+ * Соответствие неотрицательных id документов их внутренним номерам.
+ * Изменяет один писатель, читатели ищут без блокировок.
+ * Открытая адресация: ячейка - одно атомарное слово (id, номер),
+ * поэтому читатель не увидит id с чужим номером. Удалённый id остаётся
+ * в ячейке с пометкой, пока таблица не перестроится.
+ * Перестроенная таблица публикуется, а прежняя освобождается по эпохам
+ */
+class OrdinalTable {
+public:
+    /**
+     * Номер, возвращаемый для отсутствующего id
+     */
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+    /**
+     * Конструктор пустой таблицы, прежние таблицы передаются epochs
+     */
+    explicit OrdinalTable(EpochManager& epochs);
+    /**
+     * Внутренний номер документа или NOT_FOUND
+     * Читатель вызывает поиск с закреплённой эпохой
+     */
+    uint32_t Find(int document_id) const;
+    /**
+     * Добавить документ, false - если id уже есть
+     */
+    bool Insert(int document_id, uint32_t ordinal);
+    /**
+     * Удалить документ, false - если id нет
+     */
+    bool Erase(int document_id);
+    /**
+     * Количество документов
+     */
+    size_t size() const noexcept {
+        return size_;
+    }
+private:
+    /**
+     * Пустая ячейка
+     */
+    static constexpr uint64_t EMPTY_SLOT = UINT64_MAX;
+    /**
+     * Наименьший размер таблицы
+     */
+    static constexpr size_t MIN_TABLE_SIZE = 1024;
+    /**
+     * Таблица: ячейки заняты не больше чем наполовину, включая удалённые id
+     */
+    struct Table {
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+    /**
+     * Ячейка с id документа и номером
+     */
+    static uint64_t MakeSlot(int document_id, uint32_t ordinal) noexcept {
+        return (static_cast<uint64_t>(document_id) << 32) | ordinal;
+    }
+    /**
+     * Начальная ячейка поиска id
+     */
+    static size_t Home(int document_id, size_t mask) noexcept {
+        return (static_cast<uint64_t>(document_id) * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    }
+    /**
+     * Ячейка с id документа или пустая ячейка, где он должен быть
+     */
+    static size_t Locate(const Table& table, int document_id);
+    /**
+     * Перестроить таблицу без удалённых id и опубликовать её
+     */
+    void Rebuild();
+    /**
+     * Освобождение прежних таблиц
+     */
+    EpochManager& epochs_;
+    /**
+     * Текущая таблица, принадлежит писателю
+     */
+    std::shared_ptr<Table> table_;
+    /**
+     * Текущая таблица для читателей
+     */
+    std::atomic<const Table*> published_{nullptr};
+    /**
+     * Количество документов
+     */
+    size_t size_ = 0;
+    /**
+     * Количество занятых ячеек, включая удалённые id
+     */
+    size_t used_ = 0;
+};
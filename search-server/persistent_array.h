@@ -0,0 +1,126 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+/**
+ * Массив, копии которого делят неизменённые участки.
+ * Элементы хранятся участками по CHUNK_SIZE, копия массива копирует только
+ * указатели на участки, а изменение элемента сначала копирует его участок,
+ * если тот принадлежит нескольким копиям.
+ * Незаполненные участки не хранятся, их элементы равны T{}.
+ * Изменяется только копия, ещё не доступная читателям
+ */
+template <typename T, size_t CHUNK_BITS = 6>
+class PersistentArray {
+public:
+    /**
+     * Количество элементов участка
+     */
+    static constexpr size_t CHUNK_SIZE = size_t{1} << CHUNK_BITS;
+    /**
+     * Количество элементов
+     */
+    size_t size() const noexcept {
+        return size_;
+    }
+    /**
+     * Элемент по номеру или nullptr, если его участок не хранится
+     */
+    const T* Find(size_t index) const noexcept {
+        if(index >= size_) {
+            return nullptr;
+        }
+        const Chunk* chunk = chunks_[index >> CHUNK_BITS].get();
+        return chunk == nullptr ? nullptr : &(*chunk)[index & (CHUNK_SIZE - 1)];
+    }
+    /**
+     * Элемент по номеру из заполненного участка
+     */
+    const T& operator[](size_t index) const {
+        return (*chunks_[index >> CHUNK_BITS])[index & (CHUNK_SIZE - 1)];
+    }
+    /**
+     * Элемент для изменения, массив при необходимости растёт
+     * Общий с другими копиями участок предварительно копируется
+     */
+    T& Mutable(size_t index);
+    /**
+     * Дописать элемент в конец
+     */
+    void push_back(T value) {
+        Mutable(size_) = std::move(value);
+    }
+    /**
+     * Обойти элементы хранимых участков: function(номер, элемент)
+     */
+    template <typename Function>
+    void ForEach(Function function) const;
+    /**
+     * Объём массива в байтах без учёта памяти, на которую ссылаются элементы
+     */
+    size_t MemoryUsage() const noexcept;
+private:
+    /**
+     * Участок элементов
+     */
+    using Chunk = std::array<T, CHUNK_SIZE>;
+    /**
+     * Участки по старшим битам номеров элементов
+     */
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    /**
+     * Количество элементов
+     */
+    size_t size_ = 0;
+};
+/**
+ * Элемент для изменения, массив при необходимости растёт
+ * Общий с другими копиями участок предварительно копируется
+ * Участок, созданный для этой копии, принадлежит только ей и не копируется
+ */
+template <typename T, size_t CHUNK_BITS>
+T& PersistentArray<T, CHUNK_BITS>::Mutable(size_t index) {
+    if(index >= size_) {
+        size_ = index + 1;
+        chunks_.resize((size_ + CHUNK_SIZE - 1) >> CHUNK_BITS);
+    }
+    std::shared_ptr<Chunk>& chunk = chunks_[index >> CHUNK_BITS];
+    if(chunk == nullptr) {
+        chunk = std::make_shared<Chunk>();
+    } else if(chunk.use_count() > 1) {
+        chunk = std::make_shared<Chunk>(*chunk);
+    }
+    return (*chunk)[index & (CHUNK_SIZE - 1)];
+}
+/**
+ * Обойти элементы хранимых участков: function(номер, элемент)
+ */
+template <typename T, size_t CHUNK_BITS>
+template <typename Function>
+void PersistentArray<T, CHUNK_BITS>::ForEach(Function function) const {
+    for(size_t chunk_index = 0; chunk_index < chunks_.size(); ++chunk_index) {
+        const Chunk* chunk = chunks_[chunk_index].get();
+        if(chunk == nullptr) continue;
+        const size_t first = chunk_index << CHUNK_BITS;
+        const size_t count = std::min(CHUNK_SIZE, size_ - first);
+        for(size_t i = 0; i < count; ++i) {
+            function(first + i, (*chunk)[i]);
+        }
+    }
+}
+/**
+ * Объём массива в байтах без учёта памяти, на которую ссылаются элементы
+ * Общие с другими копиями участки учитываются полностью
+ */
+template <typename T, size_t CHUNK_BITS>
+size_t PersistentArray<T, CHUNK_BITS>::MemoryUsage() const noexcept {
+    size_t usage = chunks_.capacity() * sizeof(std::shared_ptr<Chunk>);
+    for(const auto& chunk : chunks_) {
+        if(chunk != nullptr) {
+            usage += sizeof(Chunk);
+        }
+    }
+    return usage;
+}
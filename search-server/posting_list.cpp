@@ -0,0 +1,458 @@
+#include "posting_list.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+/**
+ * Конструктор списка на внешних блоках без копирования
+ * Блоки и их данные должны оставаться доступными, пока список на них ссылается
+ */
+PostingList::PostingList(const Block* blocks, size_t block_count, const uint32_t* data, size_t size, double max_frequency) :
+    size_(size),
+    max_frequency_(max_frequency),
+    blocks_(blocks),
+    block_count_(block_count),
+    data_(data) { }
+/**
+ * Копия делит с исходным списком сжатые блоки, копируется только хвост
+ * Копия делается для изменения - в хвосте резервируется место под одно вхождение
+ */
+PostingList::PostingList(const PostingList& other) :
+    encoded_(other.encoded_),
+    size_(other.size_),
+    max_frequency_(other.max_frequency_),
+    blocks_(other.blocks_),
+    block_count_(other.block_count_),
+    data_(other.data_) {
+    tail_documents_.reserve(other.tail_documents_.size() + 1);
+    tail_frequencies_.reserve(other.tail_frequencies_.size() + 1);
+    tail_documents_.assign(other.tail_documents_.begin(), other.tail_documents_.end());
+    tail_frequencies_.assign(other.tail_frequencies_.begin(), other.tail_frequencies_.end());
+}
+/**
+ * Добавить вхождение слова в документ
+ * Повторное добавление для того же документа наращивает text frequency
+ */
+void PostingList::Add(uint32_t document, double tf) {
+    // документы добавляются по возрастанию номеров - обычно дописываем в хвост
+    if(block_count_ == 0 || blocks_[block_count_ - 1].last_document < document) {
+        const auto it = lower_bound(tail_documents_.begin(), tail_documents_.end(), document);
+        const auto pos = it - tail_documents_.begin();
+        if(it != tail_documents_.end() && *it == document) {
+            tail_frequencies_[pos] += tf;
+            max_frequency_ = max(max_frequency_, tail_frequencies_[pos]);
+            return;
+        }
+        tail_documents_.insert(it, document);
+        tail_frequencies_.insert(tail_frequencies_.begin() + pos, tf);
+        max_frequency_ = max(max_frequency_, tf);
+        ++size_;
+        if(tail_documents_.size() == BLOCK_SIZE) {
+            EncodedBlocks& encoded = MutableBlocks();
+            encoded.blocks.push_back(EncodeBlock(tail_documents_.data(), tail_frequencies_.data(), BLOCK_SIZE, encoded.data));
+            UpdateBlocksView();
+            tail_documents_.clear();
+            tail_frequencies_.clear();
+        }
+        return;
+    }
+    // вставка внутрь сжатых блоков - редкий случай, перестраиваем список
+    vector<uint32_t> documents;
+    vector<double> frequencies;
+    documents.reserve(size_ + 1);
+    frequencies.reserve(size_ + 1);
+    ForEach([&documents, &frequencies](uint32_t ordinal, double frequency) {
+        documents.push_back(ordinal);
+        frequencies.push_back(frequency);
+    });
+    const auto it = lower_bound(documents.begin(), documents.end(), document);
+    const auto pos = it - documents.begin();
+    if(it != documents.end() && *it == document) {
+        frequencies[pos] += tf;
+    } else {
+        documents.insert(it, document);
+        frequencies.insert(frequencies.begin() + pos, tf);
+    }
+    max_frequency_ = max(max_frequency_, frequencies[pos]);
+    Rebuild(documents, frequencies);
+}
+/**
+ * Удалить вхождение слова в документ
+ * Возвращает true, если вхождение было найдено
+ */
+bool PostingList::Remove(uint32_t document) {
+    double tf = 0;
+    const size_t block_index = FindBlock(document);
+    if(block_index == block_count_) {
+        const auto it = lower_bound(tail_documents_.begin(), tail_documents_.end(), document);
+        if(it == tail_documents_.end() || *it != document) {
+            return false;
+        }
+        const auto frequency_it = tail_frequencies_.begin() + (it - tail_documents_.begin());
+        tf = *frequency_it;
+        tail_frequencies_.erase(frequency_it);
+        tail_documents_.erase(it);
+    } else {
+        const Block block = blocks_[block_index];
+        uint32_t documents[BLOCK_SIZE];
+        double frequencies[BLOCK_SIZE];
+        DecodeDocuments(block, data_, documents);
+        const size_t pos = lower_bound(documents, documents + block.size, document) - documents;
+        if(pos == block.size || documents[pos] != document) {
+            return false;
+        }
+        DecodeFrequencies(block, data_, frequencies);
+        tf = frequencies[pos];
+        copy(documents + pos + 1, documents + block.size, documents + pos);
+        copy(frequencies + pos + 1, frequencies + block.size, frequencies + pos);
+        // блок пережимается на месте, данные следующих блоков сдвигаются
+        vector<uint32_t> encoded;
+        Block updated = {};
+        if(block.size > 1) {
+            updated = EncodeBlock(documents, frequencies, block.size - 1, encoded);
+            updated.data_offset = block.data_offset;
+        }
+        EncodedBlocks& own = MutableBlocks();
+        const auto data_it = own.data.begin() + block.data_offset;
+        const size_t old_words = BlockWords(block);
+        own.data.insert(own.data.erase(data_it, data_it + old_words), encoded.begin(), encoded.end());
+        for(size_t i = block_index + 1; i < own.blocks.size(); ++i) {
+            own.blocks[i].data_offset = static_cast<uint32_t>(own.blocks[i].data_offset - old_words + encoded.size());
+        }
+        if(block.size > 1) {
+            own.blocks[block_index] = updated;
+        } else {
+            own.blocks.erase(own.blocks.begin() + block_index);
+        }
+        UpdateBlocksView();
+    }
+    --size_;
+    // удалили документ с наибольшей text frequency - пересчитываем
+    if(tf >= max_frequency_) {
+        UpdateMaxFrequency();
+    }
+    return true;
+}
+/**
+ * Удалить вхождения слова в документы с номерами по возрастанию
+ * Список перестраивается один раз, возвращает количество удалённых вхождений
+ * Сжатый целиком список остаётся сжатым
+ */
+size_t PostingList::Remove(const std::vector<uint32_t>& documents) {
+    vector<uint32_t> kept_documents;
+    vector<double> kept_frequencies;
+    kept_documents.reserve(size_);
+    kept_frequencies.reserve(size_);
+    auto removed = documents.begin();
+    ForEach([&](uint32_t ordinal, double frequency) {
+        removed = lower_bound(removed, documents.end(), ordinal);
+        if(removed == documents.end() || *removed != ordinal) {
+            kept_documents.push_back(ordinal);
+            kept_frequencies.push_back(frequency);
+        }
+    });
+    const size_t removed_count = size_ - kept_documents.size();
+    if(removed_count == 0) return 0;
+    const bool compacted = tail_documents_.empty();
+    Rebuild(kept_documents, kept_frequencies);
+    if(compacted) {
+        Compact();
+    }
+    UpdateMaxFrequency();
+    return removed_count;
+}
+/**
+ * Содержит ли список вхождение слова в документ
+ */
+bool PostingList::Contains(uint32_t document) const {
+    const size_t block_index = FindBlock(document);
+    if(block_index == BlockCount()) {
+        return binary_search(tail_documents_.begin(), tail_documents_.end(), document);
+    }
+    const Block& block = Blocks()[block_index];
+    if(document < block.first_document) {
+        return false;
+    }
+    uint32_t documents[BLOCK_SIZE];
+    DecodeDocuments(block, Data(), documents);
+    return binary_search(documents, documents + block.size, document);
+}
+/**
+ * Сжать несжатый хвост в последний, неполный блок
+ * Для списков, в которые больше не дописывают
+ */
+void PostingList::Compact() {
+    if(tail_documents_.empty()) {
+        return;
+    }
+    EncodedBlocks& encoded = MutableBlocks();
+    encoded.blocks.push_back(EncodeBlock(tail_documents_.data(), tail_frequencies_.data(), tail_documents_.size(), encoded.data));
+    encoded.blocks.shrink_to_fit();
+    encoded.data.shrink_to_fit();
+    UpdateBlocksView();
+    vector<uint32_t>().swap(tail_documents_);
+    vector<double>().swap(tail_frequencies_);
+}
+/**
+ * Объём данных списка в байтах
+ */
+size_t PostingList::MemoryUsage() const noexcept {
+    return BlockCount() * sizeof(Block) +
+           DataWords() * sizeof(uint32_t) +
+           tail_documents_.size() * (sizeof(uint32_t) + sizeof(double));
+}
+/**
+ * Дописать список целиком, включая хвост, в виде сжатых блоков
+ * Смещения данных блоков отсчитываются от начала данных этого списка
+ */
+void PostingList::Encode(std::vector<Block>& blocks, std::vector<uint32_t>& data) const {
+    const size_t data_begin = data.size();
+    blocks.insert(blocks.end(), Blocks(), Blocks() + BlockCount());
+    data.insert(data.end(), Data(), Data() + DataWords());
+    if(!tail_documents_.empty()) {
+        Block block = EncodeBlock(tail_documents_.data(), tail_frequencies_.data(), tail_documents_.size(), data);
+        block.data_offset -= static_cast<uint32_t>(data_begin);
+        blocks.push_back(block);
+    }
+}
+/**
+ * Количество 32-битных слов данных блока
+ */
+size_t PostingList::BlockWords(const Block& block) noexcept {
+    const size_t frequency_words = block.frequency_count == 0 ?
+        block.size * sizeof(double) / sizeof(uint32_t) :
+        block.frequency_count * sizeof(double) / sizeof(uint32_t) + BitPacking::PackedWords(block.frequency_bits);
+    return BitPacking::PackedWords(block.document_bits) + frequency_words;
+}
+/**
+ * Корректно ли описание блока с данными из data_size слов
+ */
+bool PostingList::IsValidBlock(const Block& block, size_t data_size) noexcept {
+    return block.size > 0 && block.size <= BLOCK_SIZE &&
+           block.first_document <= block.last_document &&
+           block.document_bits <= 32 &&
+           (block.frequency_count == 0 ? block.frequency_bits == 0 : block.frequency_bits <= 8) &&
+           block.data_offset <= data_size &&
+           BlockWords(block) <= data_size - block.data_offset;
+}
+/**
+ * Количество 32-битных слов данных всех блоков
+ */
+size_t PostingList::DataWords() const noexcept {
+    const size_t block_count = BlockCount();
+    if(block_count == 0) {
+        return 0;
+    }
+    const Block& last = Blocks()[block_count - 1];
+    return last.data_offset + BlockWords(last);
+}
+/**
+ * Номер первого блока, который может содержать документ,
+ * или количество блоков, если документ может быть только в хвосте
+ */
+size_t PostingList::FindBlock(uint32_t document) const noexcept {
+    const Block* blocks = Blocks();
+    return partition_point(blocks, blocks + BlockCount(), [document](const Block& block) {
+        return block.last_document < document;
+    }) - blocks;
+}
+/**
+ * Сжать вхождения в блок и дописать его данные
+ * Номера документов - разностями, text frequency - таблицей различных значений
+ * и их номерами, если так выходит короче, иначе без сжатия
+ */
+PostingList::Block PostingList::EncodeBlock(const uint32_t* documents,
+                                            const double* frequencies,
+                                            size_t size,
+                                            std::vector<uint32_t>& data) {
+    Block block = {};
+    block.first_document = documents[0];
+    block.last_document = documents[size - 1];
+    block.data_offset = static_cast<uint32_t>(data.size());
+    block.size = static_cast<uint8_t>(size);
+    // неполный блок дополняется последним номером - нулевыми разностями
+    uint32_t values[BLOCK_SIZE];
+    uint32_t packed[BLOCK_SIZE];
+    copy(documents, documents + size, values);
+    fill(values + size, values + BLOCK_SIZE, documents[size - 1]);
+    const uint32_t document_bits = BitPacking::PackDelta(values, documents[0], packed);
+    block.document_bits = static_cast<uint8_t>(document_bits);
+    data.insert(data.end(), packed, packed + BitPacking::PackedWords(document_bits));
+    double codebook[BLOCK_SIZE];
+    copy(frequencies, frequencies + size, codebook);
+    sort(codebook, codebook + size);
+    const size_t codebook_size = unique(codebook, codebook + size) - codebook;
+    uint32_t frequency_bits = 0;
+    while((size_t{1} << frequency_bits) < codebook_size) {
+        ++frequency_bits;
+    }
+    const size_t raw_words = size * sizeof(double) / sizeof(uint32_t);
+    const size_t codebook_words = codebook_size * sizeof(double) / sizeof(uint32_t) + BitPacking::PackedWords(frequency_bits);
+    const size_t offset = data.size();
+    if(codebook_size > UINT8_MAX || codebook_words >= raw_words) {
+        data.resize(offset + raw_words);
+        memcpy(data.data() + offset, frequencies, size * sizeof(double));
+        return block;
+    }
+    block.frequency_count = static_cast<uint8_t>(codebook_size);
+    block.frequency_bits = static_cast<uint8_t>(frequency_bits);
+    for(size_t i = 0; i < BLOCK_SIZE; ++i) {
+        values[i] = i < size ? static_cast<uint32_t>(lower_bound(codebook, codebook + codebook_size, frequencies[i]) - codebook) : 0;
+    }
+    BitPacking::Pack(values, frequency_bits, packed);
+    data.resize(offset + codebook_size * sizeof(double) / sizeof(uint32_t));
+    memcpy(data.data() + offset, codebook, codebook_size * sizeof(double));
+    data.insert(data.end(), packed, packed + BitPacking::PackedWords(frequency_bits));
+    return block;
+}
+/**
+ * Распаковать номера документов блока, BLOCK_SIZE значений
+ */
+void PostingList::DecodeDocuments(const Block& block, const uint32_t* data, uint32_t* documents) {
+    BitPacking::UnpackDelta(data + block.data_offset, block.document_bits, block.first_document, documents);
+}
+/**
+ * Распаковать text frequency блока, block.size значений
+ */
+void PostingList::DecodeFrequencies(const Block& block, const uint32_t* data, double* frequencies) {
+    const uint32_t* words = data + block.data_offset + BitPacking::PackedWords(block.document_bits);
+    if(block.frequency_count == 0) {
+        memcpy(frequencies, words, block.size * sizeof(double));
+        return;
+    }
+    double codebook[UINT8_MAX];
+    memcpy(codebook, words, block.frequency_count * sizeof(double));
+    uint32_t indices[BLOCK_SIZE];
+    BitPacking::Unpack(words + block.frequency_count * sizeof(double) / sizeof(uint32_t), block.frequency_bits, indices);
+    const uint32_t last_index = block.frequency_count - 1u;
+    for(size_t i = 0; i < block.size; ++i) {
+        frequencies[i] = codebook[min(indices[i], last_index)];
+    }
+}
+/**
+ * Собственные блоки для изменения
+ * Внешние блоки и блоки, общие с другими копиями, предварительно копируются
+ * Копии списка изменяет только писатель, поэтому счётчик ссылок
+ * не может вырасти во время проверки
+ */
+PostingList::EncodedBlocks& PostingList::MutableBlocks() {
+    if(encoded_ == nullptr || encoded_.use_count() > 1) {
+        auto encoded = make_shared<EncodedBlocks>();
+        encoded->blocks.assign(blocks_, blocks_ + block_count_);
+        encoded->data.assign(data_, data_ + DataWords());
+        encoded_ = move(encoded);
+    }
+    return *encoded_;
+}
+/**
+ * Направить описания и данные блоков на собственные блоки
+ */
+void PostingList::UpdateBlocksView() noexcept {
+    blocks_ = encoded_->blocks.data();
+    block_count_ = encoded_->blocks.size();
+    data_ = encoded_->data.data();
+}
+/**
+ * Перестроить список из несжатых массивов
+ */
+void PostingList::Rebuild(const std::vector<uint32_t>& documents, const std::vector<double>& frequencies) {
+    auto encoded = make_shared<EncodedBlocks>();
+    size_t begin = 0;
+    for(; begin + BLOCK_SIZE <= documents.size(); begin += BLOCK_SIZE) {
+        encoded->blocks.push_back(EncodeBlock(documents.data() + begin, frequencies.data() + begin, BLOCK_SIZE, encoded->data));
+    }
+    encoded_ = move(encoded);
+    UpdateBlocksView();
+    tail_documents_.assign(documents.begin() + begin, documents.end());
+    tail_frequencies_.assign(frequencies.begin() + begin, frequencies.end());
+    size_ = documents.size();
+}
+/**
+ * Пересчитать наибольшую text frequency
+ */
+void PostingList::UpdateMaxFrequency() {
+    max_frequency_ = 0;
+    ForEach([this](uint32_t, double frequency) {
+        max_frequency_ = max(max_frequency_, frequency);
+    });
+}
+/**
+ * Конструктор.
+ * Распаковывает первый блок списка
+ */
+PostingList::Cursor::Cursor(const PostingList& postings) :
+    postings_(&postings) {
+    LoadBlock(0);
+}
+/**
+ * Перейти к первому документу с номером не меньше заданного
+ */
+void PostingList::Cursor::Seek(uint32_t document) {
+    if(documents_[position_] >= document) {
+        return;
+    }
+    if(documents_[size_ - 1] < document) {
+        // документа нет в текущем блоке - пропускаем блоки по их последним номерам
+        const Block* blocks = postings_->Blocks();
+        const size_t block_count = postings_->BlockCount();
+        size_t next = block_ + 1;
+        if(next < block_count) {
+            next = partition_point(blocks + next, blocks + block_count, [document](const Block& block) {
+                return block.last_document < document;
+            }) - blocks;
+        }
+        LoadBlock(next);
+        if(documents_[position_] >= document) {
+            return;
+        }
+    }
+    // галоп: удваиваем шаг, пока не перескочим искомый номер,
+    // затем ищем двоичным поиском внутри последнего шага
+    size_t step = 1;
+    size_t low = position_;
+    while(low + step < size_ && documents_[low + step] < document) {
+        low += step;
+        step *= 2;
+    }
+    const size_t high = min(low + step, size_);
+    position_ = lower_bound(documents_ + low + 1, documents_ + high, document) - documents_;
+    if(position_ == size_) {
+        LoadBlock(block_ + 1);
+    }
+}
+/**
+ * Распаковать номера документов блока с заданным номером
+ * Номер, равный количеству блоков, означает несжатый хвост списка
+ */
+void PostingList::Cursor::LoadBlock(size_t block) {
+    const size_t block_count = postings_->BlockCount();
+    const auto& tail = postings_->tail_documents_;
+    block_ = block;
+    position_ = 0;
+    frequencies_loaded_ = false;
+    if(block < block_count) {
+        const Block& current = postings_->Blocks()[block];
+        DecodeDocuments(current, postings_->Data(), documents_);
+        size_ = current.size;
+    } else if(block == block_count && !tail.empty()) {
+        copy(tail.begin(), tail.end(), documents_);
+        size_ = tail.size();
+    } else {
+        // список закончился
+        block_ = block_count + 1;
+        size_ = 0;
+    }
+    documents_[size_] = END;
+}
+/**
+ * Распаковать text frequency текущего блока
+ */
+void PostingList::Cursor::LoadFrequencies() {
+    if(block_ < postings_->BlockCount()) {
+        DecodeFrequencies(postings_->Blocks()[block_], postings_->Data(), frequencies_);
+    } else {
+        const auto& tail = postings_->tail_frequencies_;
+        copy(tail.begin(), tail.begin() + size_, frequencies_);
+    }
+    frequencies_loaded_ = true;
+}
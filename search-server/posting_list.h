@@ -0,0 +1,431 @@
+#pragma once
+#include "bit_packing.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+/**
+ * Список вхождений слова в документы (posting list).
+ * Внутренние номера документов хранятся по возрастанию сжатыми блоками
+ * по BLOCK_SIZE вхождений: разности номеров упакованы в минимальное число бит,
+ * text frequency - номерами в таблице различных значений блока.
+ * Последние вхождения, не набравшие полного блока, хранятся без сжатия.
+ * Блоки могут принадлежать списку или быть внешними (например,
+ * в отображённом в память файле) - тогда они копируются при первом изменении
+ */
+class PostingList {
+public:
+    /**
+     * Количество вхождений в полном блоке
+     */
+    static const size_t BLOCK_SIZE = BitPacking::BLOCK_SIZE;
+    /**
+     * Описание сжатого блока.
+     * Массив описаний служит списком пропусков при поиске документа
+     */
+    struct Block {
+        /**
+         * Наибольший номер документа в блоке
+         */
+        uint32_t last_document;
+        /**
+         * Наименьший номер документа в блоке, от него отсчитываются разности
+         */
+        uint32_t first_document;
+        /**
+         * Смещение данных блока в 32-битных словах
+         */
+        uint32_t data_offset;
+        /**
+         * Количество вхождений в блоке
+         */
+        uint8_t size;
+        /**
+         * Разрядность разностей номеров документов
+         */
+        uint8_t document_bits;
+        /**
+         * Разрядность номеров text frequency в таблице значений
+         */
+        uint8_t frequency_bits;
+        /**
+         * Размер таблицы значений text frequency,
+         * 0 - text frequency хранятся без сжатия
+         */
+        uint8_t frequency_count;
+    };
+    /**
+     * Курсор для последовательного обхода списка с пропусками.
+     * Хранит распакованный текущий блок
+     */
+    class Cursor {
+    public:
+        /**
+         * Номер документа, возвращаемый по окончании списка
+         */
+        static constexpr uint32_t END = UINT32_MAX;
+        explicit Cursor(const PostingList& postings);
+        /**
+         * Текущий документ или END
+         */
+        uint32_t Document() const {
+            return documents_[position_];
+        }
+        /**
+         * Text frequency слова в текущем документе
+         * Text frequency блока распаковываются при первом обращении
+         */
+        double Frequency() {
+            if(!frequencies_loaded_) {
+                LoadFrequencies();
+            }
+            return frequencies_[position_];
+        }
+        /**
+         * Перейти к следующему документу
+         */
+        void Next() {
+            if(++position_ >= size_) {
+                LoadBlock(block_ + 1);
+            }
+        }
+        /**
+         * Перейти к первому документу с номером не меньше заданного
+         */
+        void Seek(uint32_t document);
+    private:
+        /**
+         * Распаковать номера документов блока с заданным номером
+         * Номер, равный количеству блоков, означает несжатый хвост списка
+         */
+        void LoadBlock(size_t block);
+        /**
+         * Распаковать text frequency текущего блока
+         */
+        void LoadFrequencies();
+        /**
+         * Обходимый список
+         */
+        const PostingList* postings_;
+        /**
+         * Номер текущего блока
+         */
+        size_t block_ = 0;
+        /**
+         * Количество вхождений в текущем блоке
+         */
+        size_t size_ = 0;
+        /**
+         * Текущая позиция в блоке
+         */
+        size_t position_ = 0;
+        /**
+         * Распакованы ли text frequency текущего блока
+         */
+        bool frequencies_loaded_ = false;
+        /**
+         * Номера документов текущего блока, за ними - END
+         */
+        uint32_t documents_[BLOCK_SIZE + 1];
+        /**
+         * Text frequency текущего блока
+         */
+        double frequencies_[BLOCK_SIZE];
+    };
+    PostingList() = default;
+    /**
+     * Копия делит с исходным списком сжатые блоки, копируется только хвост
+     * Копия делается для изменения - в хвосте резервируется место под одно вхождение
+     */
+    PostingList(const PostingList& other);
+    PostingList(PostingList&&) = default;
+    PostingList& operator=(const PostingList&) = default;
+    PostingList& operator=(PostingList&&) = default;
+    /**
+     * Конструктор списка на внешних блоках без копирования
+     * Блоки и их данные должны оставаться доступными, пока список на них ссылается
+     */
+    PostingList(const Block* blocks, size_t block_count, const uint32_t* data, size_t size, double max_frequency);
+    /**
+     * Добавить вхождение слова в документ
+     * Повторное добавление для того же документа наращивает text frequency
+     */
+    void Add(uint32_t document, double tf);
+    /**
+     * Удалить вхождение слова в документ
+     * Возвращает true, если вхождение было найдено
+     */
+    bool Remove(uint32_t document);
+    /**
+     * Удалить вхождения слова в документы с номерами по возрастанию
+     * Список перестраивается один раз, возвращает количество удалённых вхождений
+     */
+    size_t Remove(const std::vector<uint32_t>& documents);
+    /**
+     * Содержит ли список вхождение слова в документ
+     */
+    bool Contains(uint32_t document) const;
+    /**
+     * Сжать несжатый хвост в последний, неполный блок
+     * Для списков, в которые больше не дописывают
+     */
+    void Compact();
+    /**
+     * Обойти вхождения по возрастанию номеров документов
+     * Функциональный объект получает номер документа и text frequency
+     */
+    template <typename Function>
+    void ForEach(Function function) const;
+    /**
+     * Обойти номера документов по возрастанию без распаковки text frequency
+     */
+    template <typename Function>
+    void ForEachDocument(Function function) const;
+    /**
+     * Обойти вхождения документов с номерами из диапазона [begin, end) по возрастанию
+     * Блоки вне диапазона пропускаются без распаковки
+     */
+    template <typename Function>
+    void ForEachInRange(uint32_t begin, uint32_t end, Function function) const;
+    /**
+     * Обойти номера документов из диапазона [begin, end) по возрастанию
+     * без распаковки text frequency
+     */
+    template <typename Function>
+    void ForEachDocumentInRange(uint32_t begin, uint32_t end, Function function) const;
+    /**
+     * Количество документов со словом
+     */
+    size_t size() const noexcept {
+        return size_;
+    }
+    /**
+     * Пуст ли список
+     */
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+    /**
+     * Наибольшая text frequency слова среди документов
+     */
+    double MaxFrequency() const noexcept {
+        return max_frequency_;
+    }
+    /**
+     * Объём данных списка в байтах
+     */
+    size_t MemoryUsage() const noexcept;
+    /**
+     * Дописать список целиком, включая хвост, в виде сжатых блоков
+     * Смещения данных блоков отсчитываются от начала данных этого списка
+     */
+    void Encode(std::vector<Block>& blocks, std::vector<uint32_t>& data) const;
+    /**
+     * Количество 32-битных слов данных блока
+     */
+    static size_t BlockWords(const Block& block) noexcept;
+    /**
+     * Корректно ли описание блока с данными из data_size слов
+     */
+    static bool IsValidBlock(const Block& block, size_t data_size) noexcept;
+private:
+    /**
+     * Собственные сжатые блоки, общие для копий списка
+     */
+    struct EncodedBlocks {
+        /**
+         * Описания сжатых блоков
+         */
+        std::vector<Block> blocks;
+        /**
+         * Данные сжатых блоков подряд
+         */
+        std::vector<uint32_t> data;
+    };
+    /**
+     * Описания блоков
+     */
+    const Block* Blocks() const noexcept {
+        return blocks_;
+    }
+    /**
+     * Количество блоков
+     */
+    size_t BlockCount() const noexcept {
+        return block_count_;
+    }
+    /**
+     * Данные блоков
+     */
+    const uint32_t* Data() const noexcept {
+        return data_;
+    }
+    /**
+     * Количество 32-битных слов данных всех блоков
+     */
+    size_t DataWords() const noexcept;
+    /**
+     * Номер первого блока, который может содержать документ,
+     * или количество блоков, если документ может быть только в хвосте
+     */
+    size_t FindBlock(uint32_t document) const noexcept;
+    /**
+     * Сжать вхождения в блок и дописать его данные
+     * Вхождений от 1 до BLOCK_SIZE, номера документов возрастают
+     */
+    static Block EncodeBlock(const uint32_t* documents,
+                             const double* frequencies,
+                             size_t size,
+                             std::vector<uint32_t>& data);
+    /**
+     * Распаковать номера документов блока, BLOCK_SIZE значений
+     */
+    static void DecodeDocuments(const Block& block, const uint32_t* data, uint32_t* documents);
+    /**
+     * Распаковать text frequency блока, block.size значений
+     */
+    static void DecodeFrequencies(const Block& block, const uint32_t* data, double* frequencies);
+    /**
+     * Собственные блоки для изменения
+     * Внешние блоки и блоки, общие с другими копиями, предварительно копируются
+     * После изменения нужно вызвать UpdateBlocksView
+     */
+    EncodedBlocks& MutableBlocks();
+    /**
+     * Направить описания и данные блоков на собственные блоки
+     */
+    void UpdateBlocksView() noexcept;
+    /**
+     * Перестроить список из несжатых массивов
+     */
+    void Rebuild(const std::vector<uint32_t>& documents, const std::vector<double>& frequencies);
+    /**
+     * Пересчитать наибольшую text frequency
+     */
+    void UpdateMaxFrequency();
+    /**
+     * Собственные сжатые блоки или nullptr, если блоки внешние или их нет
+     * Копия списка делит их с исходным, пока один из них не изменит блоки
+     */
+    std::shared_ptr<EncodedBlocks> encoded_;
+    /**
+     * Номера документов несжатого хвоста
+     */
+    std::vector<uint32_t> tail_documents_;
+    /**
+     * Text frequency несжатого хвоста
+     */
+    std::vector<double> tail_frequencies_;
+    /**
+     * Количество вхождений
+     */
+    size_t size_ = 0;
+    /**
+     * Наибольшая text frequency слова
+     */
+    double max_frequency_ = 0;
+    /**
+     * Описания блоков: собственных или внешних
+     */
+    const Block* blocks_ = nullptr;
+    /**
+     * Количество блоков
+     */
+    size_t block_count_ = 0;
+    /**
+     * Данные блоков
+     */
+    const uint32_t* data_ = nullptr;
+};
+/**
+ * Обойти вхождения по возрастанию номеров документов
+ * Функциональный объект получает номер документа и text frequency
+ */
+template <typename Function>
+void PostingList::ForEach(Function function) const {
+    uint32_t documents[BLOCK_SIZE];
+    double frequencies[BLOCK_SIZE];
+    const Block* blocks = Blocks();
+    for(size_t i = 0; i < BlockCount(); ++i) {
+        DecodeDocuments(blocks[i], Data(), documents);
+        DecodeFrequencies(blocks[i], Data(), frequencies);
+        for(size_t j = 0; j < blocks[i].size; ++j) {
+            function(documents[j], frequencies[j]);
+        }
+    }
+    for(size_t j = 0; j < tail_documents_.size(); ++j) {
+        function(tail_documents_[j], tail_frequencies_[j]);
+    }
+}
+/**
+ * Обойти номера документов по возрастанию без распаковки text frequency
+ */
+template <typename Function>
+void PostingList::ForEachDocument(Function function) const {
+    uint32_t documents[BLOCK_SIZE];
+    const Block* blocks = Blocks();
+    for(size_t i = 0; i < BlockCount(); ++i) {
+        DecodeDocuments(blocks[i], Data(), documents);
+        for(size_t j = 0; j < blocks[i].size; ++j) {
+            function(documents[j]);
+        }
+    }
+    for(const uint32_t document : tail_documents_) {
+        function(document);
+    }
+}
+/**
+ * Обойти вхождения документов с номерами из диапазона [begin, end) по возрастанию
+ * Блоки вне диапазона пропускаются без распаковки
+ */
+template <typename Function>
+void PostingList::ForEachInRange(uint32_t begin, uint32_t end, Function function) const {
+    uint32_t documents[BLOCK_SIZE];
+    double frequencies[BLOCK_SIZE];
+    const Block* blocks = Blocks();
+    const Block* blocks_end = blocks + BlockCount();
+    const Block* block = std::partition_point(blocks, blocks_end, [begin](const Block& block) {
+        return block.last_document < begin;
+    });
+    for(; block != blocks_end && block->first_document < end; ++block) {
+        DecodeDocuments(*block, Data(), documents);
+        DecodeFrequencies(*block, Data(), frequencies);
+        for(size_t j = 0; j < block->size; ++j) {
+            if(documents[j] >= begin && documents[j] < end) {
+                function(documents[j], frequencies[j]);
+            }
+        }
+    }
+    if(block != blocks_end) return;
+    const auto first = std::lower_bound(tail_documents_.begin(), tail_documents_.end(), begin);
+    for(auto it = first; it != tail_documents_.end() && *it < end; ++it) {
+        function(*it, tail_frequencies_[it - tail_documents_.begin()]);
+    }
+}
+/**
+ * Обойти номера документов из диапазона [begin, end) по возрастанию
+ * без распаковки text frequency
+ */
+template <typename Function>
+void PostingList::ForEachDocumentInRange(uint32_t begin, uint32_t end, Function function) const {
+    uint32_t documents[BLOCK_SIZE];
+    const Block* blocks = Blocks();
+    const Block* blocks_end = blocks + BlockCount();
+    const Block* block = std::partition_point(blocks, blocks_end, [begin](const Block& block) {
+        return block.last_document < begin;
+    });
+    for(; block != blocks_end && block->first_document < end; ++block) {
+        DecodeDocuments(*block, Data(), documents);
+        for(size_t j = 0; j < block->size; ++j) {
+            if(documents[j] >= begin && documents[j] < end) {
+                function(documents[j]);
+            }
+        }
+    }
+    if(block != blocks_end) return;
+    const auto first = std::lower_bound(tail_documents_.begin(), tail_documents_.end(), begin);
+    for(auto it = first; it != tail_documents_.end() && *it < end; ++it) {
+        function(*it);
+    }
+}
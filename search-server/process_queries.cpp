@@ -1,5 +1,4 @@
 #include "process_queries.h"
-#include <execution>
 /**
  * Функция, распараллеливающая обработку
  * нескольких запросов к поисковой системе.
@@ -7,26 +6,40 @@
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par,
-                   queries.begin(), queries.end(),
-                   result.begin(),
-                   [&search_server](const std::string& query) {
-        return search_server.FindTopDocuments(query);
-    });
-    return result;
+    return search_server.FindTopDocumentsBatch(queries);
 }
 /**
  * Функция, распараллеливающая обработку
  * нескольких запросов к поисковой системе.
  * Возвращает результат в "плоском" виде.
  */
-std::list<Document> ProcessQueriesJoined(
+JoinedDocuments ProcessQueriesJoined(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
-    std::list<Document> result;
-    for(const auto& documents : ProcessQueries(search_server, queries)) {
-        result.insert(result.end(), documents.begin(), documents.end());
-    }
-    return result;
-}
\ No newline at end of file
+    JoinedDocuments joined;
+    search_server.FindTopDocumentsBatchJoined(queries, joined.documents, joined.offsets);
+    return joined;
+}
+/**
+ * Функция, обрабатывающая несколько запросов
+ * к поисковой системе на потоках исполнителя.
+ */
+std::vector<std::vector<Document>> ProcessQueries(
+        const Executor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    return search_server.FindTopDocumentsBatch(executor, queries);
+}
+/**
+ * Функция, обрабатывающая несколько запросов
+ * к поисковой системе на потоках исполнителя.
+ * Возвращает результат в "плоском" виде.
+ */
+JoinedDocuments ProcessQueriesJoined(
+        const Executor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    JoinedDocuments joined;
+    search_server.FindTopDocumentsBatchJoined(executor, queries, joined.documents, joined.offsets);
+    return joined;
+}
@@ -1,6 +1,52 @@
 #pragma once
 #include "search_server.h"
-#include <list>
+#include "paginator.h"
+/**
+ * Результаты нескольких запросов в "плоском" виде.
+ * Документы всех запросов лежат подряд в одном массиве,
+ * границы результатов запросов заданы смещениями
+ */
+struct JoinedDocuments {
+    /**
+     * Начальный итератор документов всех запросов
+     */
+    auto begin() const {
+        return documents.begin();
+    }
+    /**
+     * Конечный итератор документов всех запросов
+     */
+    auto end() const {
+        return documents.end();
+    }
+    /**
+     * Количество документов всех запросов
+     */
+    size_t size() const {
+        return documents.size();
+    }
+    /**
+     * Количество запросов
+     */
+    size_t QueryCount() const {
+        return offsets.size() - 1;
+    }
+    /**
+     * Документы запроса по его номеру
+     */
+    IteratorRange<std::vector<Document>::const_iterator> QueryDocuments(size_t query_index) const {
+        return {documents.begin() + offsets[query_index], documents.begin() + offsets[query_index + 1]};
+    }
+    /**
+     * Документы всех запросов
+     */
+    std::vector<Document> documents;
+    /**
+     * Смещения начала результатов каждого запроса,
+     * последний элемент - общее количество документов
+     */
+    std::vector<size_t> offsets = {0};
+};
 /**
  * Функция, распараллеливающая обработку
  * нескольких запросов к поисковой системе.
@@ -13,6 +59,23 @@ std::vector<std::vector<Document>> ProcessQueries(
  * нескольких запросов к поисковой системе.
  * Возвращает результат в "плоском" виде.
  */
-std::list<Document> ProcessQueriesJoined(
+JoinedDocuments ProcessQueriesJoined(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries);
+/**
+ * Функция, обрабатывающая несколько запросов
+ * к поисковой системе на потоках исполнителя.
+ */
+std::vector<std::vector<Document>> ProcessQueries(
+        const Executor& executor,
         const SearchServer& search_server,
-        const std::vector<std::string>& queries);
\ No newline at end of file
+        const std::vector<std::string>& queries);
+/**
+ * Функция, обрабатывающая несколько запросов
+ * к поисковой системе на потоках исполнителя.
+ * Возвращает результат в "плоском" виде.
+ */
+JoinedDocuments ProcessQueriesJoined(
+        const Executor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries);
@@ -0,0 +1,172 @@
+#include "query_cache.h"
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+/**
+ * Конструктор счётчиков примерно для capacity ключей
+ */
+QueryCache::FrequencySketch::FrequencySketch(size_t capacity) {
+    size_t width = 64;
+    while(width < capacity) {
+        width *= 2;
+    }
+    counters_.assign(ROWS * width, 0);
+    mask_ = width - 1;
+    sample_size_ = 10 * width;
+}
+/**
+ * Учесть обращение к ключу с хэшем
+ * После sample_size_ обращений все счётчики делятся пополам
+ */
+void QueryCache::FrequencySketch::Increment(uint64_t hash) {
+    for(size_t row = 0; row < ROWS; ++row) {
+        uint8_t& counter = counters_[row * (mask_ + 1) + Index(hash, row)];
+        if(counter < MAX_COUNT) {
+            ++counter;
+        }
+    }
+    if(++additions_ >= sample_size_) {
+        for(uint8_t& counter : counters_) {
+            counter /= 2;
+        }
+        additions_ /= 2;
+    }
+}
+/**
+ * Оценка частоты обращений к ключу с хэшем: наименьший из его счётчиков
+ */
+uint32_t QueryCache::FrequencySketch::Estimate(uint64_t hash) const {
+    uint32_t estimate = MAX_COUNT;
+    for(size_t row = 0; row < ROWS; ++row) {
+        estimate = min<uint32_t>(estimate, counters_[row * (mask_ + 1) + Index(hash, row)]);
+    }
+    return estimate;
+}
+/**
+ * Номер счётчика ключа в строке
+ * Строки используют разные множители хэша
+ */
+size_t QueryCache::FrequencySketch::Index(uint64_t hash, size_t row) const noexcept {
+    static constexpr uint64_t SEEDS[ROWS] = {
+        0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull
+    };
+    return static_cast<size_t>((hash * SEEDS[row]) >> 32) & mask_;
+}
+/**
+ * Конструктор кэша объёмом не больше byte_budget байт
+ */
+QueryCache::QueryCache(size_t byte_budget, size_t shard_count) :
+    byte_budget_(byte_budget),
+    shard_budget_(byte_budget / max<size_t>(shard_count, 1)) {
+    shards_.reserve(max<size_t>(shard_count, 1));
+    for(size_t shard = 0; shard < max<size_t>(shard_count, 1); ++shard) {
+        shards_.push_back(make_unique<Shard>(shard_budget_ / EXPECTED_ENTRY_BYTES));
+    }
+}
+/**
+ * Найти результат поколения generation и скопировать его в documents
+ * Память documents переиспользуется
+ * Устаревший результат удаляется
+ */
+bool QueryCache::Find(std::string_view key, uint64_t generation, std::vector<Document>& documents) {
+    const uint64_t hash = Hash(key);
+    Shard& shard = ShardOf(hash);
+    lock_guard lock(shard.mutex);
+    shard.sketch.Increment(hash);
+    const auto it = shard.index.find(key);
+    if(it == shard.index.end()) {
+        ++shard.misses;
+        return false;
+    }
+    const auto entry = it->second;
+    if(entry->generation != generation) {
+        if(entry->generation < generation) {
+            Erase(shard, entry);
+        }
+        ++shard.misses;
+        return false;
+    }
+    // результат становится недавно использованным
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    documents.assign(entry->documents.begin(), entry->documents.end());
+    ++shard.hits;
+    return true;
+}
+/**
+ * Сохранить результат, полученный на поколении generation
+ * Результат более нового поколения не заменяется
+ * При нехватке места результат вытесняет давно не использованные,
+ * если к его ключу обращались чаще, чем к первому из вытесняемых;
+ * устаревшие результаты вытесняются без сравнения
+ */
+void QueryCache::Insert(std::string_view key, uint64_t generation, const std::vector<Document>& documents) {
+    const uint64_t hash = Hash(key);
+    const size_t bytes = sizeof(Entry) + ENTRY_OVERHEAD + key.size() + documents.size() * sizeof(Document);
+    Shard& shard = ShardOf(hash);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.index.find(key);
+    if(it != shard.index.end()) {
+        if(it->second->generation >= generation) {
+            return;
+        }
+        Erase(shard, it->second);
+    }
+    if(bytes > shard_budget_) {
+        ++shard.rejections;
+        return;
+    }
+    bool compared = false;
+    while(shard.bytes + bytes > shard_budget_) {
+        const auto victim = prev(shard.entries.end());
+        if(!compared && victim->generation >= generation) {
+            compared = true;
+            if(shard.sketch.Estimate(hash) <= shard.sketch.Estimate(victim->hash)) {
+                ++shard.rejections;
+                return;
+            }
+        }
+        Erase(shard, victim);
+        ++shard.evictions;
+    }
+    shard.entries.push_front(Entry{string(key), hash, generation, documents, bytes});
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.bytes += bytes;
+}
+/**
+ * Счётчики кэша
+ */
+QueryCache::Stats QueryCache::GetStats() const {
+    Stats stats;
+    for(const auto& shard : shards_) {
+        lock_guard lock(shard->mutex);
+        stats.hits += shard->hits;
+        stats.misses += shard->misses;
+        stats.evictions += shard->evictions;
+        stats.rejections += shard->rejections;
+        stats.entries += shard->entries.size();
+        stats.bytes += shard->bytes;
+    }
+    return stats;
+}
+/**
+ * Хэш ключа
+ */
+uint64_t QueryCache::Hash(std::string_view key) noexcept {
+    return hash<string_view>{}(key);
+}
+/**
+ * Шард ключа с хэшем
+ * Шард выбирается по старшим разрядам, счётчики частоты - по перемешанному хэшу
+ */
+QueryCache::Shard& QueryCache::ShardOf(uint64_t hash) const noexcept {
+    return *shards_[(hash >> 32) % shards_.size()];
+}
+/**
+ * Удалить результат шарда
+ */
+void QueryCache::Erase(Shard& shard, std::list<Entry>::iterator entry) {
+    shard.bytes -= entry->bytes;
+    shard.index.erase(entry->key);
+    shard.entries.erase(entry);
+}
@@ -0,0 +1,222 @@
+#pragma once
+#include "document.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+/**
+ * Кэш результатов поиска.
+ * Результат хранится с поколением индекса, на котором он получен:
+ * найденный результат другого поколения считается устаревшим.
+ * Ключи распределены по сегментам (шардам) со своей блокировкой.
+ * Внутри шарда вытесняется давно не использованный результат (LRU),
+ * а новый результат при заполненном шарде допускается, только если
+ * к его ключу обращались чаще, чем к вытесняемому (TinyLFU).
+ * Объём кэша ограничен бюджетом в байтах, поровну разделённым между шардами
+ */
+class QueryCache {
+public:
+    /**
+     * Количество шардов по умолчанию
+     */
+    static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+    /**
+     * Счётчики кэша
+     */
+    struct Stats {
+        /**
+         * Найденные результаты текущего поколения
+         */
+        size_t hits = 0;
+        /**
+         * Отсутствующие и устаревшие результаты
+         */
+        size_t misses = 0;
+        /**
+         * Результаты, вытесненные ради новых
+         */
+        size_t evictions = 0;
+        /**
+         * Новые результаты, не допущенные в кэш
+         */
+        size_t rejections = 0;
+        /**
+         * Количество хранимых результатов
+         */
+        size_t entries = 0;
+        /**
+         * Объём хранимых результатов в байтах
+         */
+        size_t bytes = 0;
+    };
+    /**
+     * Конструктор кэша объёмом не больше byte_budget байт
+     */
+    explicit QueryCache(size_t byte_budget, size_t shard_count = DEFAULT_SHARD_COUNT);
+    /**
+     * Найти результат поколения generation и скопировать его в documents
+     * Память documents переиспользуется
+     */
+    bool Find(std::string_view key, uint64_t generation, std::vector<Document>& documents);
+    /**
+     * Сохранить результат, полученный на поколении generation
+     * Результат более нового поколения не заменяется
+     */
+    void Insert(std::string_view key, uint64_t generation, const std::vector<Document>& documents);
+    /**
+     * Счётчики кэша
+     */
+    Stats GetStats() const;
+    /**
+     * Бюджет кэша в байтах
+     */
+    size_t ByteBudget() const noexcept {
+        return byte_budget_;
+    }
+private:
+    /**
+     * Оценка объёма служебных данных результата: узлы списка и таблицы
+     */
+    static constexpr size_t ENTRY_OVERHEAD = 96;
+    /**
+     * Средний объём результата для выбора размера счётчиков частоты
+     */
+    static constexpr size_t EXPECTED_ENTRY_BYTES = 256;
+    /**
+     * Приближённые частоты обращений к ключам (count-min sketch)
+     * 4-битные счётчики периодически делятся пополам, поэтому
+     * частоты отражают недавние обращения
+     */
+    class FrequencySketch {
+    public:
+        /**
+         * Конструктор счётчиков примерно для capacity ключей
+         */
+        explicit FrequencySketch(size_t capacity);
+        /**
+         * Учесть обращение к ключу с хэшем
+         */
+        void Increment(uint64_t hash);
+        /**
+         * Оценка частоты обращений к ключу с хэшем
+         */
+        uint32_t Estimate(uint64_t hash) const;
+    private:
+        /**
+         * Количество строк счётчиков
+         */
+        static constexpr size_t ROWS = 4;
+        /**
+         * Наибольшее значение счётчика
+         */
+        static constexpr uint8_t MAX_COUNT = 15;
+        /**
+         * Номер счётчика ключа в строке
+         */
+        size_t Index(uint64_t hash, size_t row) const noexcept;
+        /**
+         * Счётчики строк подряд
+         */
+        std::vector<uint8_t> counters_;
+        /**
+         * Маска номера счётчика в строке
+         */
+        size_t mask_;
+        /**
+         * Количество обращений, после которого счётчики делятся пополам
+         */
+        size_t sample_size_;
+        /**
+         * Количество обращений с последнего деления
+         */
+        size_t additions_ = 0;
+    };
+    /**
+     * Сохранённый результат
+     */
+    struct Entry {
+        /**
+         * Ключ запроса
+         */
+        std::string key;
+        /**
+         * Хэш ключа
+         */
+        uint64_t hash;
+        /**
+         * Поколение индекса, на котором получен результат
+         */
+        uint64_t generation;
+        /**
+         * Найденные документы
+         */
+        std::vector<Document> documents;
+        /**
+         * Учтённый объём результата в байтах
+         */
+        size_t bytes;
+    };
+    /**
+     * Шард кэша
+     */
+    struct alignas(64) Shard {
+        explicit Shard(size_t sketch_capacity) :
+            sketch(sketch_capacity) { }
+        /**
+         * Блокировка шарда
+         */
+        std::mutex mutex;
+        /**
+         * Результаты от недавно использованных к давно не использованным
+         */
+        std::list<Entry> entries;
+        /**
+         * Результаты по ключу, ключи хранятся в записях списка
+         */
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        /**
+         * Частоты обращений к ключам шарда
+         */
+        FrequencySketch sketch;
+        /**
+         * Объём результатов шарда в байтах
+         */
+        size_t bytes = 0;
+        /**
+         * Счётчики шарда
+         */
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t rejections = 0;
+    };
+    /**
+     * Хэш ключа
+     */
+    static uint64_t Hash(std::string_view key) noexcept;
+    /**
+     * Шард ключа с хэшем
+     */
+    Shard& ShardOf(uint64_t hash) const noexcept;
+    /**
+     * Удалить результат шарда
+     */
+    static void Erase(Shard& shard, std::list<Entry>::iterator entry);
+    /**
+     * Бюджет кэша в байтах
+     */
+    size_t byte_budget_;
+    /**
+     * Бюджет шарда в байтах
+     */
+    size_t shard_budget_;
+    /**
+     * Шарды
+     */
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
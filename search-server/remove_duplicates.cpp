@@ -1,23 +1,187 @@
 #include "remove_duplicates.h"
+#include <array>
+#include <cmath>
 #include <iostream>
+#include <unordered_map>
 
 using namespace std;
+
+namespace {
+/**
+ * Количество хэш-функций сигнатуры MinHash
+ */
+constexpr size_t SIGNATURE_SIZE = 64;
+/**
+ * Перемешать биты 64-битного значения (финализатор splitmix64)
+ */
+uint64_t Mix(uint64_t value) noexcept {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+/**
+ * Хэш набора идентификаторов слов
+ */
+uint64_t HashTerms(const vector<uint32_t>& terms) noexcept {
+    uint64_t hash = Mix(terms.size());
+    for(const uint32_t term : terms) {
+        hash = Mix(hash ^ term);
+    }
+    return hash;
+}
+/**
+ * Мера Жаккара двух наборов идентификаторов слов по возрастанию
+ */
+double Similarity(const vector<uint32_t>& lhs, const vector<uint32_t>& rhs) {
+    if(lhs.empty() && rhs.empty()) return 1;
+    size_t common = 0;
+    for(auto left = lhs.begin(), right = rhs.begin(); left != lhs.end() && right != rhs.end();) {
+        if(*left < *right) {
+            ++left;
+        } else if(*right < *left) {
+            ++right;
+        } else {
+            ++common;
+            ++left;
+            ++right;
+        }
+    }
+    return static_cast<double>(common) / (lhs.size() + rhs.size() - common);
+}
+/**
+ * Сигнатура MinHash набора слов: наименьшие значения SIGNATURE_SIZE хэш-функций
+ * Доля совпадающих значений сигнатур двух наборов оценивает их меру Жаккара
+ */
+array<uint32_t, SIGNATURE_SIZE> MinHash(const vector<uint32_t>& terms) {
+    static const auto seeds = []() {
+        array<uint64_t, SIGNATURE_SIZE> seeds;
+        for(size_t i = 0; i < SIGNATURE_SIZE; ++i) {
+            seeds[i] = Mix(i + 1);
+        }
+        return seeds;
+    }();
+    array<uint32_t, SIGNATURE_SIZE> signature;
+    signature.fill(UINT32_MAX);
+    for(const uint32_t term : terms) {
+        const uint64_t hash = Mix(term);
+        for(size_t i = 0; i < SIGNATURE_SIZE; ++i) {
+            const auto value = static_cast<uint32_t>(((hash ^ seeds[i]) * 0x9E3779B97F4A7C15ull) >> 32);
+            signature[i] = min(signature[i], value);
+        }
+    }
+    return signature;
+}
+/**
+ * Количество значений сигнатуры в полосе LSH для порога сходства
+ * Пара попадает в общую корзину хотя бы одной полосы с вероятностью
+ * 1 - (1 - s^rows)^bands, порог (1 / bands)^(1 / rows) этой кривой
+ * выбирается наибольшим, не превышающим similarity
+ */
+size_t BandRows(double similarity) {
+    size_t rows = 1;
+    while(rows < SIGNATURE_SIZE &&
+          pow(static_cast<double>(rows * 2) / SIGNATURE_SIZE, 1. / (rows * 2)) <= similarity) {
+        rows *= 2;
+    }
+    return rows;
+}
+/**
+ * Вывести найденные дубликаты по возрастанию id и удалить их одним пакетом
+ */
+void RemoveFound(SearchServer &search_server, vector<int>& ids_duplicate) {
+    sort(ids_duplicate.begin(), ids_duplicate.end());
+    for(const int document_id : ids_duplicate) {
+        cout << "Found duplicate document id "s << document_id << '\n';
+    }
+    cout.flush();
+    search_server.RemoveDocuments(ids_duplicate);
+}
+}
 /**
  * Поиск и удаление дубликатов на сервере
+ * Наборы идентификаторов слов хэшируются параллельно, документы с равными
+ * хэшами сравниваются по наборам, чтобы коллизия хэшей не удалила документ
  */
 void RemoveDuplicates(SearchServer &search_server) {
-    set<vector<string_view>> words_known;
-    set<int> ids_duplicate;
-    for (const int document_id : search_server) {
-        const auto &words_doc = search_server.GetUniqueWords(document_id);
-        if(words_known.count(words_doc) != 0) {
-            ids_duplicate.insert(document_id);
-            continue;
+    const vector<int> ids(search_server.begin(), search_server.end());
+    vector<pair<uint64_t, size_t>> hashes(ids.size());
+    vector<size_t> indexes(ids.size());
+    iota(indexes.begin(), indexes.end(), 0);
+    transform(execution::par, indexes.begin(), indexes.end(), hashes.begin(), [&](size_t i) {
+        return pair{HashTerms(search_server.GetDocumentTerms(ids[i])), i};
+    });
+    // внутри группы равных хэшей документы остаются по возрастанию id
+    sort(execution::par, hashes.begin(), hashes.end());
+    vector<int> ids_duplicate;
+    vector<vector<uint32_t>> terms_known;
+    for(auto group = hashes.begin(); group != hashes.end();) {
+        const auto group_end = find_if(group, hashes.end(), [&group](const pair<uint64_t, size_t>& entry) {
+            return entry.first != group->first;
+        });
+        if(group_end - group > 1) {
+            terms_known.clear();
+            for(auto it = group; it != group_end; ++it) {
+                vector<uint32_t> terms = search_server.GetDocumentTerms(ids[it->second]);
+                if(find(terms_known.begin(), terms_known.end(), terms) != terms_known.end()) {
+                    ids_duplicate.push_back(ids[it->second]);
+                } else {
+                    terms_known.push_back(move(terms));
+                }
+            }
         }
-        words_known.insert(words_doc);
+        group = group_end;
     }
-    for(const int document_id : ids_duplicate) {
-        cout << "Found duplicate document id "s << document_id << endl;
-        search_server.RemoveDocument(document_id);
+    RemoveFound(search_server, ids_duplicate);
+}
+/**
+ * Поиск и удаление почти дубликатов на сервере
+ * Сигнатуры MinHash считаются параллельно и делятся на полосы (LSH):
+ * документ сравнивается точной мерой Жаккара только с оставленными документами,
+ * попавшими с ним в одну корзину хотя бы одной полосы
+ */
+void RemoveNearDuplicates(SearchServer &search_server, double similarity) {
+    const vector<int> ids(search_server.begin(), search_server.end());
+    vector<vector<uint32_t>> terms(ids.size());
+    vector<array<uint32_t, SIGNATURE_SIZE>> signatures(ids.size());
+    vector<size_t> indexes(ids.size());
+    iota(indexes.begin(), indexes.end(), 0);
+    for_each(execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+        terms[i] = search_server.GetDocumentTerms(ids[i]);
+        signatures[i] = MinHash(terms[i]);
+    });
+    const size_t rows = BandRows(similarity);
+    // корзины полос хранят только оставленные документы:
+    // документ удаляется, если сходен с документом с меньшим id
+    unordered_map<uint64_t, vector<size_t>> buckets;
+    vector<size_t> compared(ids.size(), SIZE_MAX);
+    vector<uint64_t> keys(SIGNATURE_SIZE / rows);
+    vector<int> ids_duplicate;
+    for(size_t i = 0; i < ids.size(); ++i) {
+        bool duplicate = false;
+        for(size_t band = 0; band < keys.size(); ++band) {
+            uint64_t key = Mix(band);
+            for(size_t row = band * rows; row < (band + 1) * rows; ++row) {
+                key = Mix(key ^ signatures[i][row]);
+            }
+            keys[band] = key;
+            const auto bucket = buckets.find(key);
+            if(duplicate || bucket == buckets.end()) continue;
+            for(const size_t known : bucket->second) {
+                if(compared[known] == i) continue;
+                compared[known] = i;
+                if(Similarity(terms[i], terms[known]) >= similarity) {
+                    duplicate = true;
+                    break;
+                }
+            }
+        }
+        if(duplicate) {
+            ids_duplicate.push_back(ids[i]);
+            continue;
+        }
+        for(const uint64_t key : keys) {
+            buckets[key].push_back(i);
+        }
     }
+    RemoveFound(search_server, ids_duplicate);
 }
@@ -2,5 +2,14 @@
 #include "search_server.h"
 /**
  * Поиск и удаление дубликатов на сервере
+ * Дубликат - документ с тем же набором слов, что у документа с меньшим id
  */
 void RemoveDuplicates(SearchServer &search_server);
+/**
+ * Поиск и удаление почти дубликатов на сервере
+ * Почти дубликат - документ, набор слов которого сходен с набором слов
+ * документа с меньшим id по мере Жаккара не меньше similarity
+ * Кандидаты отбираются приближённо по сигнатурам MinHash,
+ * поэтому часть пар со сходством около порога может быть пропущена
+ */
+void RemoveNearDuplicates(SearchServer &search_server, double similarity);
@@ -0,0 +1,23 @@
+#include "score_accumulator.h"
+
+using namespace std;
+/**
+ * Конструктор.
+ * Принимает количество внутренних номеров документов
+ */
+ScoreAccumulator::ScoreAccumulator(size_t document_count) :
+    scores_(document_count),
+    flags_(document_count) { }
+/**
+ * Очистить накопленные значения и задать количество внутренних номеров документов
+ * Очищаются только затронутые документы
+ */
+void ScoreAccumulator::Reset(size_t document_count) {
+    for(const uint32_t ordinal : touched_) {
+        scores_[ordinal] = 0;
+        flags_[ordinal] = 0;
+    }
+    touched_.clear();
+    scores_.resize(document_count);
+    flags_.resize(document_count);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+/**
+ * Накопитель релевантности документов.
+ * Плотный массив по внутренним номерам документов без блокировок,
+ * рассчитан на использование одним потоком
+ */
+class ScoreAccumulator {
+public:
+    /**
+     * Конструктор.
+     * Принимает количество внутренних номеров документов
+     */
+    explicit ScoreAccumulator(size_t document_count = 0);
+    /**
+     * Очистить накопленные значения и задать количество внутренних номеров документов
+     * Очищаются только затронутые документы
+     */
+    void Reset(size_t document_count);
+    /**
+     * Нарастить релевантность документа
+     */
+    void Add(uint32_t ordinal, double relevance) {
+        Touch(ordinal, SCORED);
+        scores_[ordinal] += relevance;
+    }
+    /**
+     * Исключить документ из выдачи
+     */
+    void Exclude(uint32_t ordinal) {
+        Touch(ordinal, EXCLUDED);
+    }
+    /**
+     * Есть ли у документа релевантность
+     */
+    bool IsScored(uint32_t ordinal) const {
+        return flags_[ordinal] & SCORED;
+    }
+    /**
+     * Исключён ли документ из выдачи
+     */
+    bool IsExcluded(uint32_t ordinal) const {
+        return flags_[ordinal] & EXCLUDED;
+    }
+    /**
+     * Накопленная релевантность документа
+     */
+    double Score(uint32_t ordinal) const {
+        return scores_[ordinal];
+    }
+    /**
+     * Затронутые документы в порядке первого обращения
+     */
+    const std::vector<uint32_t>& Touched() const noexcept {
+        return touched_;
+    }
+private:
+    /**
+     * Признаки документа
+     */
+    enum Flag : uint8_t {
+        SCORED = 1,
+        EXCLUDED = 2,
+    };
+    /**
+     * Отметить обращение к документу
+     */
+    void Touch(uint32_t ordinal, Flag flag) {
+        if(flags_[ordinal] == 0) {
+            touched_.push_back(ordinal);
+        }
+        flags_[ordinal] |= flag;
+    }
+    /**
+     * Релевантность по внутреннему номеру документа
+     */
+    std::vector<double> scores_;
+    /**
+     * Признаки по внутреннему номеру документа
+     */
+    std::vector<uint8_t> flags_;
+    /**
+     * Затронутые документы
+     */
+    std::vector<uint32_t> touched_;
+};
@@ -0,0 +1,65 @@
+#include "search_paginator.h"
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+/**
+ * Описание ошибки - некорректный размер страницы
+ */
+const char* SearchPaginator::ERROR_PAGE_SIZE = "Некорректный размер страницы";
+/**
+ * Конструктор выдачи запроса raw_query по документам со статусом status
+ * страницами по page_size документов
+ */
+SearchPaginator::SearchPaginator(const SearchServer& search_server,
+                                 std::string raw_query,
+                                 DocumentStatus status,
+                                 size_t page_size) :
+    server_(search_server),
+    raw_query_(move(raw_query)),
+    status_(status),
+    page_size_(page_size) {
+    if(page_size_ == 0) {
+        throw invalid_argument(ERROR_PAGE_SIZE);
+    }
+}
+/**
+ * Страница с номером page, нумерация с нуля
+ * Сервер отбирает лучшие (page + 1) × размер страницы документов,
+ * из них возвращается последняя страница
+ */
+std::vector<Document> SearchPaginator::GetPage(size_t page) const {
+    // страница за последним документом индекса заведомо пуста
+    if(page >= numeric_limits<size_t>::max() / page_size_ ||
+       page * page_size_ >= static_cast<size_t>(server_.GetDocumentCount())) {
+        return {};
+    }
+    vector<Document> documents = server_.FindTopDocuments(raw_query_, status_, (page + 1) * page_size_);
+    const size_t skipped = min(documents.size(), page * page_size_);
+    documents.erase(documents.begin(), documents.begin() + skipped);
+    return documents;
+}
+/**
+ * Следующая страница курсора, пустая после последней
+ * Первый вызов возвращает первую страницу
+ * Страница ищется после последнего выданного документа,
+ * поэтому сервер отбирает не больше размера страницы документов
+ */
+std::vector<Document> SearchPaginator::Next() {
+    if(exhausted_) return {};
+    vector<Document> documents = last_
+        ? server_.FindTopDocumentsAfter(raw_query_, *last_, status_, page_size_)
+        : server_.FindTopDocuments(raw_query_, status_, page_size_);
+    exhausted_ = documents.size() < page_size_;
+    if(!documents.empty()) {
+        last_ = documents.back();
+    }
+    return documents;
+}
+/**
+ * Вернуть курсор к первой странице
+ */
+void SearchPaginator::Rewind() {
+    last_.reset();
+    exhausted_ = false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "search_server.h"
+#include "document.h"
+#include <optional>
+#include <string>
+#include <vector>
+/**
+ * Постраничная выдача запроса к серверу.
+ * Страницы не готовятся заранее: каждая запрашивается у сервера при обращении,
+ * и сервер отбирает только нужное для неё число документов.
+ * Страница по номеру отбирается ограниченной кучей из (номер + 1) × размер страницы
+ * лучших документов, а курсор получает следующую страницу поиском после
+ * последнего документа предыдущей (search-after) - её стоимость от номера не зависит
+ */
+class SearchPaginator {
+public:
+    /**
+     * Описание ошибки - некорректный размер страницы
+     */
+    static const char* ERROR_PAGE_SIZE;
+    /**
+     * Конструктор выдачи запроса raw_query по документам со статусом status
+     * страницами по page_size документов
+     */
+    SearchPaginator(const SearchServer& search_server,
+                    std::string raw_query,
+                    DocumentStatus status,
+                    size_t page_size);
+    /**
+     * Страница с номером page, нумерация с нуля
+     */
+    std::vector<Document> GetPage(size_t page) const;
+    /**
+     * Следующая страница курсора, пустая после последней
+     * Первый вызов возвращает первую страницу
+     */
+    std::vector<Document> Next();
+    /**
+     * Вернуть курсор к первой странице
+     */
+    void Rewind();
+    /**
+     * Количество документов на странице
+     */
+    size_t PageSize() const noexcept {
+        return page_size_;
+    }
+private:
+    /**
+     * Поисковой сервер
+     */
+    const SearchServer& server_;
+    /**
+     * Запрос
+     */
+    std::string raw_query_;
+    /**
+     * Статус документов выдачи
+     */
+    DocumentStatus status_;
+    /**
+     * Количество документов на странице
+     */
+    size_t page_size_;
+    /**
+     * Последний документ, выданный курсором
+     */
+    std::optional<Document> last_;
+    /**
+     * Выдал ли курсор последнюю страницу
+     */
+    bool exhausted_ = false;
+};
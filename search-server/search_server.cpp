@@ -1,5 +1,6 @@
 #include "search_server.h"
 #include <math.h>
+#include <cstddef>
 
 using namespace std;
 /**
@@ -14,6 +15,228 @@ const char* SearchServer::ERROR_MINUS_WORD_EXTRADASH = "Минус-слово с
  * Пустой контейнер слов и text frequency
  */
 const std::map<std::string_view, double> SearchServer::EMPTY_DOC_MEASURES = {};
+// слова прямого индекса читаются из снимка без копирования
+static_assert(sizeof(IndexSnapshot::DocumentTermEntry) == sizeof(IndexSegment::DocumentTerm) &&
+              offsetof(IndexSnapshot::DocumentTermEntry, term) == offsetof(IndexSegment::DocumentTerm, term) &&
+              offsetof(IndexSnapshot::DocumentTermEntry, tf) == offsetof(IndexSegment::DocumentTerm, tf),
+              "раскладка слов прямого индекса снимка не совпадает с IndexSegment::DocumentTerm");
+/**
+ * Открыть сервер из бинарного снимка
+ * Списки вхождений и прямой индекс читаются прямо из отображённого в память файла
+ * Сжатые блоки не распаковываются, а контрольная сумма не считается - это делает VerifySnapshot
+ */
+SearchServer SearchServer::OpenSnapshot(const std::string& path) {
+    auto file = make_shared<const MappedFile>(path);
+    const IndexSnapshot snapshot(*file);
+    const auto& header = snapshot.GetHeader();
+    vector<string_view> stop_words;
+    stop_words.reserve(header.stop_word_count);
+    for(size_t i = 0; i < header.stop_word_count; ++i) {
+        stop_words.push_back(snapshot.StopWord(i));
+    }
+    SearchServer server(stop_words);
+    server.snapshot_file_ = file;
+    // снимок целиком становится одним закрытым сегментом
+    auto segment = make_shared<IndexSegment>(0);
+    // документы: слова прямого индекса ссылаются на отображённый файл
+    const auto* document_terms = reinterpret_cast<const IndexSegment::DocumentTerm*>(snapshot.DocumentTerms());
+    for(uint32_t ordinal = 0; ordinal < header.document_count; ++ordinal) {
+        const auto& entry = snapshot.GetDocumentEntry(ordinal);
+        if(entry.id < 0 ||
+           entry.status < static_cast<int32_t>(DocumentStatus::ACTUAL) ||
+           entry.status > static_cast<int32_t>(DocumentStatus::REMOVED) ||
+           entry.terms_begin > header.document_term_count ||
+           entry.term_count > header.document_term_count - entry.terms_begin ||
+           !server.segments_->ordinals.Insert(entry.id, ordinal)) {
+            throw invalid_argument(IndexSnapshot::ERROR_SNAPSHOT_FORMAT);
+        }
+        // идентификаторы слов документа индексируют словарь и количества документов со словом
+        const IndexSegment::DocumentTerm* terms = document_terms + entry.terms_begin;
+        for(size_t j = 0; j < entry.term_count; ++j) {
+            if(terms[j].term >= header.term_count || (j > 0 && terms[j].term <= terms[j - 1].term)) {
+                throw invalid_argument(IndexSnapshot::ERROR_SNAPSHOT_FORMAT);
+            }
+        }
+        DocumentData data;
+        data.rating = entry.rating;
+        data.status = static_cast<DocumentStatus>(entry.status);
+        segment->AppendDocument(entry.id, data, {terms, entry.term_count});
+        server.document_ids_.emplace_hint(server.document_ids_.end(), entry.id);
+    }
+    // словарь: списки вхождений ссылаются на отображённый файл
+    // слова сохранены без повторов, поэтому их идентификаторы совпадают с номерами в снимке
+    for(size_t i = 0; i < header.term_count; ++i) {
+        PostingList postings = SnapshotPostings(snapshot, i);
+        const uint32_t term = server.terms_.Intern(snapshot.Term(i));
+        if(term != i) {
+            throw invalid_argument(IndexSnapshot::ERROR_SNAPSHOT_FORMAT);
+        }
+        segment->AttachPostings(term, move(postings));
+    }
+    // сервер ещё никто не читает - версия меняется на месте
+    IndexVersion& version = *server.segments_->version;
+    if(segment->Span() > 0) {
+        version.segments.front() = make_shared<IndexSegment>(segment->EndOrdinal());
+        CountSealedTerms(version, *segment);
+        version.segments.insert(version.segments.begin(), move(segment));
+    }
+    version.document_count = header.document_count;
+    return server;
+}
+/**
+ * Проверить снимок целиком: контрольную сумму и порядок и границы
+ * номеров документов внутри сжатых блоков списков вхождений
+ * Читает весь файл, поэтому отделена от открытия снимка
+ */
+void SearchServer::VerifySnapshot(const std::string& path) {
+    const MappedFile file(path);
+    const IndexSnapshot snapshot(file);
+    snapshot.VerifyChecksum();
+    const auto& header = snapshot.GetHeader();
+    // номера документов распаковываются из каждого списка вхождений
+    uint64_t postings_size = 0;
+    for(size_t i = 0; i < header.term_count; ++i) {
+        int64_t previous = -1;
+        bool valid = true;
+        SnapshotPostings(snapshot, i).ForEach([&](uint32_t ordinal, double) {
+            valid = valid && ordinal > previous && ordinal < header.document_count;
+            previous = ordinal;
+        });
+        if(!valid) {
+            throw invalid_argument(IndexSnapshot::ERROR_SNAPSHOT_FORMAT);
+        }
+        postings_size += snapshot.GetTermEntry(i).postings_size;
+    }
+    // слов прямого индекса столько же, сколько вхождений, их порядок проверяет OpenSnapshot
+    if(postings_size != header.document_term_count) {
+        throw invalid_argument(IndexSnapshot::ERROR_SNAPSHOT_FORMAT);
+    }
+}
+/**
+ * Список вхождений слова снимка по номеру в словаре снимка
+ * Проверяет границы списка и заголовки его блоков, не распаковывая их
+ */
+PostingList SearchServer::SnapshotPostings(const IndexSnapshot& snapshot, size_t index) {
+    const auto& header = snapshot.GetHeader();
+    const auto& entry = snapshot.GetTermEntry(index);
+    if(entry.blocks_begin > header.block_count ||
+       entry.block_count > header.block_count - entry.blocks_begin ||
+       entry.block_data_begin > header.block_data_size) {
+        throw invalid_argument(IndexSnapshot::ERROR_SNAPSHOT_FORMAT);
+    }
+    const PostingList::Block* blocks = snapshot.Blocks() + entry.blocks_begin;
+    const size_t data_size = header.block_data_size - entry.block_data_begin;
+    size_t postings_size = 0;
+    for(size_t j = 0; j < entry.block_count; ++j) {
+        if(!PostingList::IsValidBlock(blocks[j], data_size) ||
+           blocks[j].last_document >= header.document_count ||
+           (j > 0 && blocks[j].first_document <= blocks[j - 1].last_document)) {
+            throw invalid_argument(IndexSnapshot::ERROR_SNAPSHOT_FORMAT);
+        }
+        postings_size += blocks[j].size;
+    }
+    if(postings_size != entry.postings_size) {
+        throw invalid_argument(IndexSnapshot::ERROR_SNAPSHOT_FORMAT);
+    }
+    return PostingList(blocks,
+                       entry.block_count,
+                       snapshot.BlockData() + entry.block_data_begin,
+                       entry.postings_size,
+                       entry.max_frequency);
+}
+/**
+ * Сохранить индекс в бинарный снимок
+ * Внутренние номера документов при сохранении уплотняются
+ */
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    const auto guard = segments_->epochs.Pin();
+    const IndexVersion& version = segments_->Current();
+    // удалённые документы не сохраняются, оставшиеся нумеруются подряд
+    vector<uint32_t> new_ordinals(version.segments.back()->EndOrdinal(), PostingList::Cursor::END);
+    vector<const IndexSegment::DocumentRecord*> documents;
+    documents.reserve(version.document_count);
+    for(const auto& segment : version.segments) {
+        segment->LiveDocuments().ForEachInRange(segment->FirstOrdinal(), segment->EndOrdinal(), [&](uint32_t ordinal) {
+            new_ordinals[ordinal] = static_cast<uint32_t>(documents.size());
+            documents.push_back(&segment->Document(ordinal));
+        });
+    }
+    // слова сохраняются по алфавиту, их списки вхождений - подряд в общих массивах блоков
+    // слова, добавленные после публикации версии, не имеют в ней вхождений и пропускаются
+    const size_t term_count = terms_.size();
+    vector<pair<string_view, uint32_t>> words;
+    words.reserve(term_count);
+    for(uint32_t term = 0; term < term_count; ++term) {
+        words.emplace_back(terms_.Term(term), term);
+    }
+    sort(words.begin(), words.end());
+    vector<string_view> terms;
+    vector<uint32_t> new_terms(term_count, PostingList::Cursor::END);
+    vector<IndexSnapshot::TermEntry> term_entries;
+    vector<PostingList::Block> blocks;
+    vector<uint32_t> block_data;
+    terms.reserve(words.size());
+    term_entries.reserve(words.size());
+    for(const auto& [word, term] : words) {
+        // списки сегментов пережимаются в один с уплотнёнными номерами документов
+        PostingList renumbered;
+        for(const auto& segment : version.segments) {
+            const PostingList* postings = segment->FindPostings(term);
+            if(postings == nullptr) continue;
+            // вхождения помеченных удалёнными документов пропускаются
+            postings->ForEach([&renumbered, &new_ordinals](uint32_t ordinal, double frequency) {
+                if(new_ordinals[ordinal] != PostingList::Cursor::END) {
+                    renumbered.Add(new_ordinals[ordinal], frequency);
+                }
+            });
+        }
+        if(renumbered.empty()) continue;
+        new_terms[term] = static_cast<uint32_t>(terms.size());
+        terms.push_back(word);
+        const size_t blocks_begin = blocks.size();
+        const size_t block_data_begin = block_data.size();
+        renumbered.Encode(blocks, block_data);
+        term_entries.push_back({blocks_begin,
+                                blocks.size() - blocks_begin,
+                                block_data_begin,
+                                renumbered.size(),
+                                renumbered.MaxFrequency()});
+    }
+    // прямой индекс: слова документов перенумерованы по словарю снимка и снова упорядочены
+    vector<IndexSnapshot::DocumentEntry> document_entries;
+    vector<IndexSnapshot::DocumentTermEntry> document_terms;
+    document_entries.reserve(documents.size());
+    for(const IndexSegment::DocumentRecord* document : documents) {
+        const size_t terms_begin = document_terms.size();
+        for(const auto& [term, tf] : document->terms) {
+            document_terms.push_back({new_terms[term], 0, tf});
+        }
+        sort(document_terms.begin() + terms_begin, document_terms.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.term < rhs.term;
+        });
+        document_entries.push_back({document->id,
+                                    document->data.rating,
+                                    static_cast<int32_t>(document->data.status),
+                                    static_cast<uint32_t>(document_terms.size() - terms_begin),
+                                    terms_begin});
+    }
+    IndexSnapshot::Writer writer(path);
+    IndexSnapshot::Header header = {};
+    header.stop_word_count = stop_words_.size();
+    header.stop_words_offset = writer.WriteStrings(stop_words_);
+    header.term_count = terms.size();
+    header.terms_offset = writer.WriteStrings(terms);
+    header.term_entries_offset = writer.WriteArray(term_entries);
+    header.block_count = blocks.size();
+    header.blocks_offset = writer.WriteArray(blocks);
+    header.block_data_size = block_data.size();
+    header.block_data_offset = writer.WriteArray(block_data);
+    header.document_count = document_entries.size();
+    header.documents_offset = writer.WriteArray(document_entries);
+    header.document_term_count = document_terms.size();
+    header.document_terms_offset = writer.WriteArray(document_terms);
+    writer.Finish(header);
+}
 /**
  * Начальный итератор загруженных id документов
  */
@@ -33,61 +256,314 @@ void SearchServer::AddDocument(int document_id,
                                string_view document,
                                DocumentStatus status,
                                const std::vector<int>& ratings) {
-    if(document_id < 0 || documents_.count(document_id)  || !StringProcessing::IsValidWord(document)) {
+    vector<string_view> document_words;
+    if(document_id < 0 || !SplitIntoWordsNoStop(document, document_words)) {
+        throw invalid_argument(Document::ERROR_DOCUMENT_ID + " = '"s + to_string(document_id) + "'"s);
+    }
+    lock_guard lock(segments_->mutex);
+    if(segments_->ordinals.Find(document_id) != OrdinalTable::NOT_FOUND) {
         throw invalid_argument(Document::ERROR_DOCUMENT_ID + " = '"s + to_string(document_id) + "'"s);
     }
-    const auto& words = SplitIntoWordsNoStop(document);
-    const double tf_increment = 1./ words.size();
-    for(const auto& word : words) {
-        words_measures_[std::string(word)][document_id] += tf_increment; // здесь наращиваем text frequency
-        document_measures_[document_id][word] += tf_increment;
+    vector<uint32_t> words;
+    words.reserve(document_words.size());
+    for(const auto& word : document_words) {
+        words.push_back(terms_.Intern(word));
     }
-    documents_.emplace(document_id, DocumentData{ratings, status}); // обновляем количество документов в сервере
+    // документ дописывается в копию буферного сегмента новой версии
+    const shared_ptr<IndexVersion> draft = segments_->CopyVersion();
+    IndexSegment& buffer = SegmentState::MutableSegment(*draft, draft->segments.size() - 1);
+    const uint32_t ordinal = buffer.EndOrdinal();
+    buffer.AddDocument(document_id, DocumentData{ratings, status}, words);
+    ++draft->document_count; // обновляем количество документов в сервере
+    ++draft->generation;
+    const bool sealed = buffer.Span() >= BUFFER_DOCUMENTS;
+    if(sealed) {
+        SealBuffer(*draft);
+    }
+    segments_->Publish(draft);
+    segments_->ordinals.Insert(document_id, ordinal);
     document_ids_.emplace(document_id); // добавляем id документа в список добавленных
+    if(sealed) {
+        SignalMerger();
+    }
+}
+/**
+ * Добавить пакет новых документов
+ * Документы добавляются все или, при ошибке в любом из них, ни один
+ */
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddDocumentsIn(execution::par, documents);
+}
+/**
+ * Добавить пакет новых документов
+ * Последовательная реализация
+ */
+void SearchServer::AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents) {
+    AddDocumentsIn(execution::seq, documents);
+}
+/**
+ * Добавить пакет новых документов
+ * Многопоточная реализация: документы разбираются и индексируются параллельно
+ */
+void SearchServer::AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents) {
+    AddDocumentsIn(execution::par, documents);
 }
 /**
 * Найти документы, отсортированные по релевантности запросу
 * Вариант со статусом документа в качестве параметра
-* Выводит максимум MAX_RESULT_DOCUMENT_COUNT документов
+* Выводит максимум top_count документов
 */
 std::vector<Document> SearchServer::FindTopDocuments(string_view raw_query,
-                                                     DocumentStatus input_status) const {
-    return FindTopDocuments(raw_query, [input_status](int, DocumentStatus status, int) { return status == input_status; });
+                                                     DocumentStatus input_status,
+                                                     size_t top_count) const {
+    return FindTopDocuments(execution::seq, raw_query, input_status, top_count);
+}
+/**
+ * Найти документы, следующие в порядке выдачи за документом after (search-after)
+ * Продолжает выдачу с последнего документа предыдущей страницы:
+ * отбирается только top_count документов, сколько бы страниц ни было пройдено
+ * Результат зависит от after и в кэш не попадает
+ */
+std::vector<Document> SearchServer::FindTopDocumentsAfter(std::string_view raw_query,
+                                                          const Document& after,
+                                                          DocumentStatus input_status,
+                                                          size_t top_count) const {
+    QueryContext& context = GetQueryContext();
+    FindTopDocumentsIn(execution::seq,
+                       context,
+                       raw_query,
+                       [input_status](const IndexSegment& segment) -> const DocumentBitmap& {
+        return segment.StatusDocuments(input_status);
+    },
+                       [](const IndexSegment::DocumentRecord&) { return true; },
+                       top_count,
+                       nullopt,
+                       after);
+    return context.documents;
+}
+/**
+ * Найти документы, отсортированные по релевантности запросу
+ * Вариант с рабочими буферами вызывающего и статусом документа в качестве параметра
+ * Выдача хранится в контексте до следующего запроса с ним
+ */
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context,
+                                                            std::string_view raw_query,
+                                                            DocumentStatus input_status,
+                                                            size_t top_count) const {
+    FindTopDocumentsIn(execution::seq,
+                       context,
+                       raw_query,
+                       [input_status](const IndexSegment& segment) -> const DocumentBitmap& {
+        return segment.StatusDocuments(input_status);
+    },
+                       [](const IndexSegment::DocumentRecord&) { return true; },
+                       top_count,
+                       input_status);
+    return context.documents;
+}
+/**
+ * Найти документы для пакета запросов
+ * Общие слова запросов ищутся в словаре один раз,
+ * запросы выполняются параллельно на рабочих буферах потоков
+ * Для каждого запроса выводит максимум top_count документов
+ */
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+                                                                       DocumentStatus input_status,
+                                                                       size_t top_count) const {
+    return FindTopDocumentsBatchIn(execution::par, raw_queries, input_status, top_count);
+}
+/**
+ * Найти документы для пакета запросов
+ * Запросы выполняются на потоках исполнителя,
+ * небольшой пакет выполняется последовательно
+ * Для каждого запроса выводит максимум top_count документов
+ */
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const Executor& executor,
+                                                                       const std::vector<std::string>& raw_queries,
+                                                                       DocumentStatus input_status,
+                                                                       size_t top_count) const {
+    return FindTopDocumentsBatchIn(executor, raw_queries, input_status, top_count);
+}
+/**
+ * Найти документы для пакета запросов и сложить выдачи подряд в documents
+ * offsets - смещения начала выдачи каждого запроса,
+ * последний элемент - общее количество документов
+ * Запросы выполняются параллельно на рабочих буферах потоков
+ */
+void SearchServer::FindTopDocumentsBatchJoined(const std::vector<std::string>& raw_queries,
+                                               std::vector<Document>& documents,
+                                               std::vector<size_t>& offsets,
+                                               DocumentStatus input_status,
+                                               size_t top_count) const {
+    FindTopDocumentsBatchJoinedIn(execution::par, raw_queries, documents, offsets, input_status, top_count);
+}
+/**
+ * Найти документы для пакета запросов и сложить выдачи подряд в documents
+ * Запросы выполняются на потоках исполнителя
+ */
+void SearchServer::FindTopDocumentsBatchJoined(const Executor& executor,
+                                               const std::vector<std::string>& raw_queries,
+                                               std::vector<Document>& documents,
+                                               std::vector<size_t>& offsets,
+                                               DocumentStatus input_status,
+                                               size_t top_count) const {
+    FindTopDocumentsBatchJoinedIn(executor, raw_queries, documents, offsets, input_status, top_count);
+}
+/**
+ * Найти документы для пакета запросов с политикой исполнения
+ */
+template <typename ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatchIn(const ExecutionPolicy& policy,
+                                                                         const std::vector<std::string>& raw_queries,
+                                                                         DocumentStatus input_status,
+                                                                         size_t top_count) const {
+    vector<vector<Document>> result;
+    RunQueryBatch(policy,
+                  raw_queries,
+                  input_status,
+                  top_count,
+                  [&result](size_t query_count, size_t) {
+        result.resize(query_count);
+    },
+                  [&result](size_t index, TopDocuments& top_documents) {
+        result[index] = top_documents.Extract();
+    });
+    return result;
+}
+/**
+ * Найти документы для пакета запросов с политикой исполнения
+ * и сложить выдачи подряд в documents
+ * Каждый запрос пишет выдачу прямо в documents на своё место
+ * наибольшего размера, затем выдачи сдвигаются вплотную друг к другу
+ */
+template <typename ExecutionPolicy>
+void SearchServer::FindTopDocumentsBatchJoinedIn(const ExecutionPolicy& policy,
+                                                 const std::vector<std::string>& raw_queries,
+                                                 std::vector<Document>& documents,
+                                                 std::vector<size_t>& offsets,
+                                                 DocumentStatus input_status,
+                                                 size_t top_count) const {
+    size_t stride = 0;
+    RunQueryBatch(policy,
+                  raw_queries,
+                  input_status,
+                  top_count,
+                  [&](size_t query_count, size_t result_bound) {
+        stride = result_bound;
+        documents.resize(query_count * stride);
+        offsets.assign(query_count + 1, 0);
+    },
+                  [&](size_t index, TopDocuments& top_documents) {
+        const auto begin = documents.begin() + index * stride;
+        offsets[index + 1] = top_documents.Extract(begin) - begin;
+    });
+    // смещения пока хранят размеры выдач: превращаем их в начала
+    // и сдвигаем выдачи к началу массива, место назначения всегда левее источника
+    for (size_t index = 0; index + 1 < offsets.size(); ++index) {
+        const auto begin = documents.begin() + index * stride;
+        const size_t count = offsets[index + 1];
+        move(begin, begin + count, documents.begin() + offsets[index]);
+        offsets[index + 1] = offsets[index] + count;
+    }
+    documents.resize(offsets.back());
+}
+/**
+ * Выполнить пакет запросов с политикой исполнения
+ * До запуска вызывается reserve(количество запросов, наибольший размер выдачи),
+ * выдача каждого запроса передаётся в store(номер запроса, выдача)
+ * Стоимость пакета для исполнителя оценивается сверху: каждый запрос
+ * может обойти все документы индекса
+ */
+template <typename ExecutionPolicy, typename Reserve, typename Store>
+void SearchServer::RunQueryBatch(const ExecutionPolicy& policy,
+                                 const std::vector<std::string>& raw_queries,
+                                 DocumentStatus input_status,
+                                 size_t top_count,
+                                 Reserve reserve,
+                                 Store store) const {
+    // разбираем запросы последовательно, чтобы ошибки разбора дошли до вызывающего
+    vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for(const string& raw_query : raw_queries) {
+        queries.push_back(ParseQuery(raw_query));
+    }
+    // уникальные слова пакета ищем в словаре один раз
+    vector<string_view> words;
+    for(const Query& query : queries) {
+        words.insert(words.end(), query.words_plus.begin(), query.words_plus.end());
+        words.insert(words.end(), query.words_minus.begin(), query.words_minus.end());
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    vector<ResolvedWord> resolved(words.size());
+    // весь пакет выполняется на одной версии индекса
+    const auto guard = segments_->epochs.Pin();
+    const IndexVersion& version = segments_->Current();
+    PolicyForEach(policy, words.size(), words.size(), [&](size_t index) {
+        resolved[index] = ResolveWord(words[index], version);
+    });
+    const auto resolve = [&words, &resolved](string_view word) {
+        return resolved[lower_bound(words.begin(), words.end(), word) - words.begin()];
+    };
+    const auto accept_all = [](const IndexSegment::DocumentRecord&) {
+        return true;
+    };
+    // в выдачу не попадёт больше документов, чем есть в индексе
+    const size_t result_bound = min(top_count, version.document_count);
+    reserve(queries.size(), result_bound);
+    // выполняем запросы параллельно, каждый поток работает на своих буферах
+    PolicyForEach(policy, queries.size(), queries.size() * version.document_count, [&](size_t index) {
+        QueryContext& context = GetQueryContext();
+        ResolveQuery(queries[index], resolve, context.words, context.resolved);
+        TopDocuments& top_documents = context.top_documents;
+        top_documents.Reset(result_bound);
+        for(const auto& segment : version.segments) {
+            PrepareQuery(context.resolved, *segment, context.prepared);
+            FindAllDocuments(*segment,
+                             context.prepared,
+                             segment->StatusDocuments(input_status),
+                             accept_all,
+                             top_documents,
+                             context.scoring);
+        }
+        store(index, top_documents);
+    });
 }
 /**
  * Количество загруженных документов
  */
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    const auto guard = segments_->epochs.Pin();
+    return static_cast<int>(segments_->Current().document_count);
 }
 /**
  * Совпадающие слова в запросе к конкретному документу и статус документа
  */
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query,
                                                                                  int document_id) const {
-    if(document_id < 0 || documents_.count(document_id) == 0) {
+    const Query& query_parsed = ParseQuery(raw_query, true);
+    const auto guard = segments_->epochs.Pin();
+    const IndexSegment::DocumentRecord* document_record = FindDocument(segments_->Current(), document_id);
+    if(document_record == nullptr) {
         throw out_of_range(Document::ERROR_DOCUMENT_INDEX + " = '"s + to_string(document_id) + "'"s);
     }
+    const IndexSegment::DocumentRecord& document = *document_record;
+    const DocumentStatus status = document.data.status;
     vector<string_view> words_matched;
-    const Query& query_parsed = ParseQuery(raw_query, true);
     // проверяем на наличие минус-слов в документе
     for(const string_view word : query_parsed.words_minus) {
-        if(words_measures_.count(std::string(word)) == 0 ||
-           words_measures_.at(std::string(word)).count(document_id) == 0) {
-            continue;
+        if(HasTerm(document, terms_.Find(word))) {
+            return {words_matched, status};
         }
-        return {words_matched, documents_.at(document_id).status};
     }
     // добавляем совпавшие с запросом плюс слова
     words_matched.reserve(query_parsed.words_plus.size());
     for(const string_view word : query_parsed.words_plus) {
-        if(words_measures_.count(std::string(word)) == 0 ||
-           words_measures_.at(std::string(word)).count(document_id) == 0) {
-            continue;
+        if(HasTerm(document, terms_.Find(word))) {
+            words_matched.push_back(word);
         }
-        words_matched.push_back(word);
     }
-    return {words_matched, documents_.at(document_id).status};
+    return {words_matched, status};
 }
 /**
  * Совпадающие слова в запросе к конкретному документу и статус документа.
@@ -105,20 +581,24 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&,
                                                                    std::string_view raw_query,
                                                                    int document_id) const {
-    if(document_id < 0 || documents_.count(document_id) == 0) {
+    const Query& query_parsed = ParseQuery(raw_query);
+    const auto guard = segments_->epochs.Pin();
+    const IndexSegment::DocumentRecord* document_record = FindDocument(segments_->Current(), document_id);
+    if(document_record == nullptr) {
         throw out_of_range(Document::ERROR_DOCUMENT_INDEX + " = '"s + to_string(document_id) + "'"s);
     }
-    const Query& query_parsed = ParseQuery(raw_query);
-    const auto& doc_measures = document_measures_.at(document_id);
+    const IndexSegment::DocumentRecord& document = *document_record;
+    const DocumentStatus status = document.data.status;
     vector<string_view> words_matched;
+    const auto has_word = [this, &document](const string_view word) {
+        return HasTerm(document, terms_.Find(word));
+    };
     // проверяем на наличие минус-слов в документе
     if (any_of(std::execution::par,
                query_parsed.words_minus.begin(),
                query_parsed.words_minus.end(),
-               [&doc_measures](const auto word) {
-               return doc_measures.count(word);
-    })) {
-        return {words_matched, documents_.at(document_id).status};
+               has_word)) {
+        return {words_matched, status};
     }
     // добавляем совпавшие с запросом плюс слова
     words_matched.reserve(query_parsed.words_plus.size());
@@ -126,49 +606,116 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
             query_parsed.words_plus.begin(),
             query_parsed.words_plus.end(),
             back_inserter(words_matched),
-            [&doc_measures](const auto word) {
-        return doc_measures.count(word);
-    });
+            has_word);
     sort(std::execution::par, words_matched.begin(), words_matched.end());
     auto it = std::unique(words_matched.begin(), words_matched.end());
     words_matched.erase(it, words_matched.end());
-    return {words_matched, documents_.at(document_id).status};
+    return {words_matched, status};
+}
+/**
+ * Совпадающие слова в запросе к конкретному документу и статус документа.
+ * Реализация на потоках исполнителя, короткий запрос проверяется последовательно
+ * Стоимость проверки оценивается количеством слов запроса
+ */
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const Executor& executor,
+                                                                   std::string_view raw_query,
+                                                                   int document_id) const {
+    const Query& query_parsed = ParseQuery(raw_query);
+    const auto guard = segments_->epochs.Pin();
+    const IndexSegment::DocumentRecord* document_record = FindDocument(segments_->Current(), document_id);
+    if(document_record == nullptr) {
+        throw out_of_range(Document::ERROR_DOCUMENT_INDEX + " = '"s + to_string(document_id) + "'"s);
+    }
+    const IndexSegment::DocumentRecord& document = *document_record;
+    const DocumentStatus status = document.data.status;
+    vector<string_view> words_matched;
+    const auto has_word = [this, &document](const string_view word) {
+        return HasTerm(document, terms_.Find(word));
+    };
+    // проверяем на наличие минус-слов в документе
+    const vector<string_view>& words_minus = query_parsed.words_minus;
+    atomic<bool> has_minus = false;
+    executor.ParallelFor(words_minus.size(), [&](size_t index) {
+        if (has_word(words_minus[index])) {
+            has_minus.store(true, memory_order_relaxed);
+        }
+    });
+    if (has_minus.load(memory_order_relaxed)) {
+        return {words_matched, status};
+    }
+    // добавляем совпавшие с запросом плюс слова
+    const vector<string_view>& words_plus = query_parsed.words_plus;
+    vector<char> matched(words_plus.size());
+    executor.ParallelFor(words_plus.size(), [&](size_t index) {
+        matched[index] = has_word(words_plus[index]);
+    });
+    words_matched.reserve(words_plus.size());
+    for (size_t index = 0; index < words_plus.size(); ++index) {
+        if (matched[index]) {
+            words_matched.push_back(words_plus[index]);
+        }
+    }
+    sort(words_matched.begin(), words_matched.end());
+    words_matched.erase(unique(words_matched.begin(), words_matched.end()), words_matched.end());
+    return {words_matched, status};
 }
 /**
  * Получить text frequency слов по id документа
  */
 const std::map<string_view, double> &SearchServer::GetWordFrequencies(int document_id) const {
-    if(document_measures_.count(document_id) == 0) return EMPTY_DOC_MEASURES;
-    return document_measures_.at(document_id);
+    const auto guard = segments_->epochs.Pin();
+    // документ ищется под блокировкой кэша: удаление публикует версию до очистки кэша,
+    // поэтому в кэш не попадут слова удалённого документа или прежнего документа с тем же id
+    lock_guard lock(word_frequencies_->mutex);
+    const IndexSegment::DocumentRecord* document = FindDocument(segments_->Current(), document_id);
+    if(document == nullptr) return EMPTY_DOC_MEASURES;
+    // узлы map не перемещаются - ссылка остаётся действительной после снятия блокировки
+    const auto [it, inserted] = word_frequencies_->documents.try_emplace(document_id);
+    if(inserted) {
+        for(const auto& [term, tf] : document->terms) {
+            it->second.emplace(terms_.Term(term), tf);
+        }
+    }
+    return it->second;
 }
 /**
  * Получить уникальные слова документа
  */
 const std::vector<string_view> SearchServer::GetUniqueWords(int document_id) const {
-    const auto &words_tf = GetWordFrequencies(document_id);
     vector<string_view> words;
-    words.reserve(words_tf.size());
-    transform(words_tf.begin(), words_tf.end(), back_inserter(words), [](const pair<string_view, double>& v) {
-        return v.first;
+    const auto guard = segments_->epochs.Pin();
+    const IndexSegment::DocumentRecord* document = FindDocument(segments_->Current(), document_id);
+    if(document == nullptr) return words;
+    const auto& terms = document->terms;
+    words.reserve(terms.size());
+    transform(terms.begin(), terms.end(), back_inserter(words), [this](const IndexSegment::DocumentTerm& term) {
+        return terms_.Term(term.term);
     });
+    sort(words.begin(), words.end());
     return words;
 }
+/**
+ * Получить идентификаторы слов документа по возрастанию
+ * Идентификаторы назначает словарь сервера, у одинаковых слов разных документов они совпадают
+ */
+std::vector<uint32_t> SearchServer::GetDocumentTerms(int document_id) const {
+    vector<uint32_t> terms;
+    const auto guard = segments_->epochs.Pin();
+    const IndexSegment::DocumentRecord* document = FindDocument(segments_->Current(), document_id);
+    if(document == nullptr) return terms;
+    terms.reserve(document->terms.size());
+    for(const auto& [term, tf] : document->terms) {
+        terms.push_back(term);
+    }
+    return terms;
+}
 /**
  * Удалить документ по его id
+ * Документ закрытого сегмента только помечается удалённым,
+ * его вхождения вычищает фоновое слияние или уплотнение сегмента
  */
 void SearchServer::RemoveDocument(int document_id) {
-    if(documents_.count(document_id) == 0 &&
-       document_ids_.count(document_id) == 0 &&
-       document_measures_.count(document_id) == 0) return;
-    // вычищаем измерения документа в словаре
-    const auto &doc_measure = document_measures_.at(document_id);
-    for(const auto& [word, tf] : doc_measure) {
-        words_measures_.at(std::string(word)).erase(document_id);
-    }
-    // вычищаем данные о документе в остальных переменных
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    document_measures_.erase(document_id);
+    RemoveDocuments(vector<int>{document_id});
 }
 /**
  * Удалить документ по его id
@@ -179,22 +726,79 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int d
 }
 /**
  * Удалить документ по его id
- * Многопоточная реализация
+ * Многопоточная реализация: пометка удалённым не требует параллельного вычищения
  */
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
-    if(documents_.count(document_id) == 0 &&
-       document_ids_.count(document_id) == 0 &&
-       document_measures_.count(document_id) == 0) return;
-    // вычищаем измерения документа в словаре
-    const auto& doc_measure = document_measures_.at(document_id);
-    std::for_each(std::execution::par,
-                  doc_measure.begin(), doc_measure.end(),
-                  [this, &document_id] (const auto& pair) {
-        words_measures_.at(std::string(pair.first)).erase(document_id);
+    RemoveDocument(document_id);
+}
+/**
+ * Удалить документ по его id
+ * Вариант с исполнителем: пометка удалённым выполняется в вызывающем потоке
+ */
+void SearchServer::RemoveDocument(const Executor&, int document_id) {
+    RemoveDocument(document_id);
+}
+/**
+ * Удалить документы по их id
+ * Все документы удаляются одной новой версией индекса
+ */
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    vector<int> ids = document_ids;
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    lock_guard lock(segments_->mutex);
+    const auto missing = [this](int document_id) {
+        return segments_->ordinals.Find(document_id) == OrdinalTable::NOT_FOUND;
+    };
+    ids.erase(remove_if(ids.begin(), ids.end(), missing), ids.end());
+    if(ids.empty()) return;
+    vector<uint32_t> ordinals(ids.size());
+    transform(ids.begin(), ids.end(), ordinals.begin(), [this](int document_id) {
+        return segments_->ordinals.Find(document_id);
     });
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    document_measures_.erase(document_id);
+    sort(ordinals.begin(), ordinals.end());
+    const shared_ptr<IndexVersion> draft = segments_->CopyVersion();
+    const bool compact = RemoveOrdinals(*draft, ordinals);
+    draft->document_count -= ids.size();
+    ++draft->generation;
+    segments_->Publish(draft);
+    // вычищаем данные о документах в остальных переменных
+    for(const int document_id : ids) {
+        segments_->ordinals.Erase(document_id);
+        document_ids_.erase(document_id);
+    }
+    if(compact) {
+        SignalMerger();
+    }
+    lock_guard cache_lock(word_frequencies_->mutex);
+    for(const int document_id : ids) {
+        word_frequencies_->documents.erase(document_id);
+    }
+}
+/**
+ * Объём сжатых списков вхождений в байтах
+ */
+size_t SearchServer::GetPostingsMemoryUsage() const {
+    const auto guard = segments_->epochs.Pin();
+    size_t usage = 0;
+    for(const auto& segment : segments_->Current().segments) {
+        usage += segment->PostingsMemoryUsage();
+    }
+    return usage;
+}
+/**
+ * Включить кэш результатов поиска по статусу объёмом не больше byte_budget байт
+ * Нулевой бюджет выключает кэш
+ * Вызывается, пока к серверу нет обращений
+ */
+void SearchServer::SetQueryCache(size_t byte_budget, size_t shard_count) {
+    query_cache_ = byte_budget == 0 ? nullptr : make_unique<QueryCache>(byte_budget, shard_count);
+}
+/**
+ * Счётчики кэша результатов поиска, нулевые при выключенном кэше
+ */
+QueryCache::Stats SearchServer::GetQueryCacheStats() const {
+    return query_cache_ == nullptr ? QueryCache::Stats{} : query_cache_->GetStats();
 }
 /**
  * Является ли слово стоп-словом
@@ -204,24 +808,29 @@ bool SearchServer::IsStopWord(string_view word) const {
 }
 /**
  * Разложить входной текст в вектор из слов, исключая известные стоп-слова
+ * Возвращает false, если текст содержит недопустимый символ
+ * Текст разбирается и проверяется за один проход
  */
-std::vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
-    std::vector<std::string_view> words;
-    for (const auto& word : StringProcessing::SplitIntoWordsView(text)) {
-        if (IsStopWord(word)) {
-            continue;
+bool SearchServer::SplitIntoWordsNoStop(string_view text, std::vector<std::string_view>& words) const {
+    vector<StringProcessing::WordSpan>& spans = GetWordSpans();
+    if(!StringProcessing::SplitIntoWordSpans(text, spans)) {
+        return false;
+    }
+    words.clear();
+    words.reserve(spans.size());
+    for(const auto& span : spans) {
+        const string_view word = text.substr(span.begin, span.length);
+        if(!IsStopWord(word)) {
+            words.push_back(word);
         }
-        words.push_back(word);
     }
-    return words;
+    return true;
 }
 /**
  * Получить слово запроса из текста
+ * Символы слова проверены при разборе запроса
  */
 SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
-    if(!StringProcessing::IsValidWord(text)) {
-             throw invalid_argument("");
-    }
     QueryWord qw({text, (text.front() == '-'), IsStopWord(text)});
     if(!qw.is_minus) return qw;
     qw.text.remove_prefix(1);
@@ -229,10 +838,7 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         throw invalid_argument(ERROR_MINUS_WORD_EMPTY);
     }
     if(qw.text.front() == '-') {
-        throw invalid_argument(ERROR_MINUS_WORD_EXTRADASH + " '"s + qw.text.data() + "'"s);
-    }
-    if(!StringProcessing::IsValidWord(qw.text)) {
-         throw invalid_argument("Error");
+        throw invalid_argument(ERROR_MINUS_WORD_EXTRADASH);
     }
     return qw;
 }
@@ -242,8 +848,25 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
  */
 SearchServer::Query SearchServer::ParseQuery(std::string_view text,  bool need_unique) const {
     Query query;
-    for (const auto word : StringProcessing::SplitIntoWordsView(text)) {
-        const QueryWord& query_word = ParseQueryWord(word);
+    ParseQuery(text, need_unique, query, GetQueryContext().spans);
+    return query;
+}
+/**
+ * Получить структурированный запрос из текста в query
+ * Границы слов размечаются в spans, память query и spans переиспользуется
+ */
+void SearchServer::ParseQuery(std::string_view text,
+                              bool need_unique,
+                              Query& query,
+                              std::vector<StringProcessing::WordSpan>& spans) const {
+    query.words_plus.clear();
+    query.words_minus.clear();
+    // слова разбираются и проверяются за один проход
+    if(!StringProcessing::SplitIntoWordSpans(text, spans)) {
+        throw invalid_argument("");
+    }
+    for (const auto& span : spans) {
+        const QueryWord& query_word = ParseQueryWord(text.substr(span.begin, span.length));
         if (query_word.is_stop) {
             continue; // отсеиваем стоп-слова
         }
@@ -257,7 +880,7 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text,  bool need_u
     }
     // если не нужно удалять повторяющиеся элементы - возвращаем результат
     if(!need_unique) {
-        return query;
+        return;
     }
     // сортируем
     sort(query.words_minus.begin(), query.words_minus.end());
@@ -269,30 +892,466 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text,  bool need_u
     query.words_minus.erase(last_minus, query.words_minus.end());
     // для плюс слов
     query.words_plus.erase(last_plus, query.words_plus.end());
-    return query;
 }
 /**
- * Вычислить IDF для слова
+ * Ключ кэша результатов: плюс-слова запроса по порядку с повторами,
+ * минус-слова по порядку без повторов, статус и размер выдачи
+ * Повторы плюс-слова меняют его вес, повторы минус-слова ни на что не влияют
  */
-double SearchServer::CalcIdf(const std::string_view word) const {
-    if(word.empty()) return 0;
-    return log(static_cast<double>(GetDocumentCount())/ words_measures_.at(std::string(word)).size());
+void SearchServer::MakeCacheKey(const Query& query,
+                                DocumentStatus status,
+                                size_t top_count,
+                                std::vector<std::string_view>& words,
+                                std::string& key) {
+    key.assign(to_string(static_cast<int>(status)));
+    key += ' ';
+    key += to_string(top_count);
+    words.assign(query.words_plus.begin(), query.words_plus.end());
+    sort(words.begin(), words.end());
+    for(const string_view word : words) {
+        key += ' ';
+        key += word;
+    }
+    words.assign(query.words_minus.begin(), query.words_minus.end());
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    for(const string_view word : words) {
+        key += " -"sv;
+        key += word;
+    }
 }
 /**
- * Содержатся ли минус-слова в документе
+ * Содержит ли документ слово с идентификатором
  */
-bool SearchServer::IsDocHasMinus(const std::pair<int, double>& doc,
-                                 const std::vector<std::string_view>& words_minus) const {
-    for (const auto word : words_minus) {
-        if(words_measures_.count(std::string(word)) == 0) {
-            continue;
+bool SearchServer::HasTerm(const IndexSegment::DocumentRecord& document, uint32_t term) {
+    const auto it = lower_bound(document.terms.begin(), document.terms.end(), term, [](const IndexSegment::DocumentTerm& lhs, uint32_t rhs) {
+        return lhs.term < rhs;
+    });
+    return it != document.terms.end() && it->term == term;
+}
+/**
+ * Номер сегмента версии, содержащего внутренний номер документа
+ */
+size_t SearchServer::FindSegment(const IndexVersion& version, uint32_t ordinal) {
+    const auto it = upper_bound(version.segments.begin(), version.segments.end(), ordinal, [](uint32_t lhs, const shared_ptr<IndexSegment>& rhs) {
+        return lhs < rhs->FirstOrdinal();
+    });
+    return static_cast<size_t>(it - version.segments.begin()) - 1;
+}
+/**
+ * Неудалённый документ версии по id или nullptr
+ * Соответствие id номерам общее для всех версий, поэтому номер проверяется
+ * по версии: документ мог быть добавлен или удалён после её публикации
+ */
+const IndexSegment::DocumentRecord* SearchServer::FindDocument(const IndexVersion& version, int document_id) const {
+    if(document_id < 0) return nullptr;
+    const uint32_t ordinal = segments_->ordinals.Find(document_id);
+    if(ordinal == OrdinalTable::NOT_FOUND || ordinal >= version.segments.back()->EndOrdinal()) return nullptr;
+    const IndexSegment& segment = *version.segments[FindSegment(version, ordinal)];
+    if(!segment.LiveDocuments().Contains(ordinal)) return nullptr;
+    const IndexSegment::DocumentRecord& document = segment.Document(ordinal);
+    return document.id == document_id ? &document : nullptr;
+}
+/**
+ * Вычислить IDF для слова по числу содержащих его документов
+ */
+double SearchServer::CalcIdf(size_t document_frequency, size_t document_count) {
+    return log(static_cast<double>(document_count)/ document_frequency);
+}
+/**
+ * Вычислить релевантность документа по его прямому индексу
+ * Вклады слов суммируются по возрастанию идентификаторов, как и при
+ * параллельном поиске, поэтому релевантность не зависит от способа поиска
+ */
+double SearchServer::CalcRelevance(const IndexSegment::DocumentRecord& document, const std::vector<ResolvedTerm>& terms) {
+    double relevance = 0;
+    auto position = document.terms.begin();
+    for(const auto& [term, weight] : terms) {
+        position = lower_bound(position, document.terms.end(), term, [](const IndexSegment::DocumentTerm& document_term, uint32_t term) {
+            return document_term.term < term;
+        });
+        if(position == document.terms.end()) break;
+        if(position->term == term) {
+            relevance += position->tf * weight;
         }
-        for (const auto& measures : words_measures_.at(std::string(word))) {
-            if(doc.first != measures.first) {
-                continue;
+    }
+    return relevance;
+}
+/**
+ * Найти слово в словаре и вычислить его IDF по версии
+ * Количество документов со словом в закрытых сегментах хранится в версии,
+ * поэтому вместо обхода всех сегментов к нему добавляются вхождения буферного
+ * Вызывается с закреплённой эпохой
+ */
+SearchServer::ResolvedWord SearchServer::ResolveWord(std::string_view word, const IndexVersion& version) const {
+    const uint32_t term = terms_.Find(word);
+    if(term == TermDictionary::NOT_FOUND) return {};
+    const uint32_t* sealed_frequency = version.sealed_frequencies->Find(term);
+    size_t document_frequency = sealed_frequency == nullptr ? 0 : *sealed_frequency;
+    const PostingList* buffered = version.segments.back()->FindPostings(term);
+    if(buffered != nullptr) {
+        document_frequency += buffered->size();
+    }
+    if(document_frequency == 0) return {};
+    return {term, CalcIdf(document_frequency, version.document_count)};
+}
+/**
+ * Подготовить запрос к выполнению в сегменте
+ * Слова без вхождений в сегмент отбрасываются
+ */
+void SearchServer::PrepareQuery(const ResolvedQuery& query, const IndexSegment& segment, PreparedQuery& prepared) {
+    prepared.terms_plus.clear();
+    prepared.terms_by_id.clear();
+    prepared.postings_minus.clear();
+    for(const auto& [term, weight] : query.terms_plus) {
+        const PostingList* postings = segment.FindPostings(term);
+        if(postings != nullptr) {
+            prepared.terms_plus.push_back({postings, weight, weight * postings->MaxFrequency()});
+            prepared.terms_by_id.push_back({term, weight});
+        }
+    }
+    sort(prepared.terms_plus.begin(), prepared.terms_plus.end(), [](const QueryTerm& lhs, const QueryTerm& rhs) {
+        return lhs.upper_bound < rhs.upper_bound;
+    });
+    for(const uint32_t term : query.terms_minus) {
+        const PostingList* postings = segment.FindPostings(term);
+        if(postings != nullptr) {
+            prepared.postings_minus.push_back(postings);
+        }
+    }
+}
+/**
+ * Оценка стоимости поиска в сегменте: количество вхождений слов запроса
+ */
+size_t SearchServer::QueryCost(const ResolvedQuery& query, const IndexSegment& segment) {
+    size_t cost = 0;
+    for(const auto& [term, weight] : query.terms_plus) {
+        if(const PostingList* postings = segment.FindPostings(term)) {
+            cost += postings->size();
+        }
+    }
+    for(const uint32_t term : query.terms_minus) {
+        if(const PostingList* postings = segment.FindPostings(term)) {
+            cost += postings->size();
+        }
+    }
+    return cost;
+}
+/**
+ * Добавить пакет новых документов с политикой исполнения
+ * Пакет становится отдельным закрытым сегментом после буферного
+ * и публикуется одной версией индекса
+ */
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentsIn(ExecutionPolicy policy, const std::vector<NewDocument>& documents) {
+    if(documents.empty()) {
+        return;
+    }
+    // разбор документов и поиск известных слов идут без блокировки:
+    // словарь можно читать одновременно с добавлением слов другим писателем
+    vector<size_t> indexes(documents.size());
+    iota(indexes.begin(), indexes.end(), 0);
+    vector<vector<string_view>> words(documents.size());
+    vector<vector<uint32_t>> terms(documents.size());
+    vector<char> valid(documents.size());
+    for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        valid[i] = documents[i].id >= 0 && SplitIntoWordsNoStop(documents[i].text, words[i]);
+        terms[i].reserve(words[i].size());
+        for(const string_view word : words[i]) {
+            terms[i].push_back(terms_.Find(word));
+        }
+    });
+    const auto invalid = find(valid.begin(), valid.end(), false);
+    if(invalid != valid.end()) {
+        const int document_id = documents[invalid - valid.begin()].id;
+        throw invalid_argument(Document::ERROR_DOCUMENT_ID + " = '"s + to_string(document_id) + "'"s);
+    }
+    vector<int> ids(documents.size());
+    transform(documents.begin(), documents.end(), ids.begin(), [](const NewDocument& document) {
+        return document.id;
+    });
+    sort(policy, ids.begin(), ids.end());
+    const auto repeated = adjacent_find(ids.begin(), ids.end());
+    if(repeated != ids.end()) {
+        throw invalid_argument(Document::ERROR_DOCUMENT_ID + " = '"s + to_string(*repeated) + "'"s);
+    }
+    lock_guard lock(segments_->mutex);
+    for(const int document_id : ids) {
+        if(segments_->ordinals.Find(document_id) != OrdinalTable::NOT_FOUND) {
+            throw invalid_argument(Document::ERROR_DOCUMENT_ID + " = '"s + to_string(document_id) + "'"s);
+        }
+    }
+    // новые слова добавляет в словарь один поток
+    for(size_t i = 0; i < documents.size(); ++i) {
+        for(size_t j = 0; j < terms[i].size(); ++j) {
+            if(terms[i][j] == TermDictionary::NOT_FOUND) {
+                terms[i][j] = terms_.Intern(words[i][j]);
             }
+        }
+    }
+    vector<IndexSegment::DocumentRecord> records(documents.size());
+    transform(policy, indexes.begin(), indexes.end(), records.begin(), [&](size_t i) {
+        const NewDocument& document = documents[i];
+        return IndexSegment::MakeDocument(document.id, DocumentData{document.ratings, document.status}, terms[i]);
+    });
+    const shared_ptr<IndexVersion> draft = segments_->CopyVersion();
+    const uint32_t first_ordinal = draft->segments.back()->EndOrdinal();
+    // непустой буферный сегмент закрывается, пустой уступает место пакету
+    if(draft->segments.back()->Span() > 0) {
+        SegmentState::MutableSegment(*draft, draft->segments.size() - 1).Seal();
+        CountSealedTerms(*draft, *draft->segments.back());
+    } else {
+        draft->segments.pop_back();
+    }
+    if constexpr(is_same_v<ExecutionPolicy, execution::parallel_policy>) {
+        draft->segments.push_back(make_shared<IndexSegment>(IndexSegment::Build(policy, first_ordinal, move(records))));
+    } else {
+        draft->segments.push_back(make_shared<IndexSegment>(IndexSegment::Build(first_ordinal, move(records))));
+    }
+    CountSealedTerms(*draft, *draft->segments.back());
+    draft->segments.push_back(make_shared<IndexSegment>(draft->segments.back()->EndOrdinal()));
+    draft->document_count += documents.size();
+    ++draft->generation;
+    segments_->Publish(draft);
+    for(size_t i = 0; i < documents.size(); ++i) {
+        segments_->ordinals.Insert(documents[i].id, first_ordinal + static_cast<uint32_t>(i));
+        document_ids_.emplace(documents[i].id);
+    }
+    SignalMerger();
+}
+/**
+ * Разбудить поток слияния, запустив его при первом закрытом сегменте
+ * Вызывается под блокировкой писателей
+ */
+void SearchServer::SignalMerger() {
+    if(!segments_->merger.joinable()) {
+        segments_->merger = thread(RunMerges, segments_.get());
+    }
+    segments_->merge_signal.notify_one();
+}
+/**
+ * Закрыть буферный сегмент неопубликованной версии и начать новый
+ * Вызывается под блокировкой писателей
+ */
+void SearchServer::SealBuffer(IndexVersion& draft) {
+    SegmentState::MutableSegment(draft, draft.segments.size() - 1).Seal();
+    CountSealedTerms(draft, *draft.segments.back());
+    draft.segments.push_back(make_shared<IndexSegment>(draft.segments.back()->EndOrdinal()));
+}
+/**
+ * Учесть слова закрытого сегмента в количествах документов со словом
+ * Массив копируется один раз на весь сегмент, а не на каждый документ
+ */
+void SearchServer::CountSealedTerms(IndexVersion& draft, const IndexSegment& segment) {
+    PersistentArray<uint32_t>& frequencies = SegmentState::MutableFrequencies(draft);
+    segment.ForEachPostings([&frequencies](uint32_t term, const PostingList& postings) {
+        frequencies.Mutable(term) += static_cast<uint32_t>(postings.size());
+    });
+}
+/**
+ * Исключить слова документа, удаляемого из сегмента с номером index,
+ * из количеств документов со словом, если сегмент закрыт
+ * Документ буферного сегмента в количествах ещё не учтён
+ */
+void SearchServer::UncountSealedDocument(IndexVersion& draft, size_t index, uint32_t ordinal) {
+    if(index + 1 == draft.segments.size()) return;
+    PersistentArray<uint32_t>& frequencies = SegmentState::MutableFrequencies(draft);
+    for(const auto& [term, tf] : draft.segments[index]->Document(ordinal).terms) {
+        --frequencies.Mutable(term);
+    }
+}
+/**
+ * Удалить документы с внутренними номерами по возрастанию из неопубликованной версии
+ * Документы закрытых сегментов помечаются удалёнными, буферного - вычищаются сразу:
+ * количества документов со словом для буферного сегмента берутся из его списков
+ * Возвращает true, если какой-то из затронутых сегментов пора уплотнить
+ */
+bool SearchServer::RemoveOrdinals(IndexVersion& draft, const std::vector<uint32_t>& ordinals) {
+    bool compact = false;
+    vector<uint32_t> buffered;
+    for(auto it = ordinals.begin(); it != ordinals.end();) {
+        const size_t index = FindSegment(draft, *it);
+        const uint32_t end_ordinal = draft.segments[index]->EndOrdinal();
+        IndexSegment& segment = SegmentState::MutableSegment(draft, index);
+        if(index + 1 == draft.segments.size()) {
+            buffered.assign(it, ordinals.end());
+            segment.RemoveDocuments(buffered);
+            break;
+        }
+        for(; it != ordinals.end() && *it < end_ordinal; ++it) {
+            UncountSealedDocument(draft, index, *it);
+            segment.MarkRemoved(*it);
+        }
+        compact = compact || NeedsCompaction(segment);
+    }
+    return compact;
+}
+/**
+ * Пора ли уплотнить закрытый сегмент
+ */
+bool SearchServer::NeedsCompaction(const IndexSegment& segment) {
+    const size_t removed = segment.RemovedDocuments();
+    return removed > 0 && removed * COMPACTION_RATIO >= removed + segment.LiveDocuments().size();
+}
+/**
+ * Найти подряд идущие сегменты одного уровня для слияния [begin, end)
+ * или один сегмент для уплотнения
+ * Буферный сегмент не сливается
+ */
+bool SearchServer::SelectMerge(const IndexVersion& version, size_t& begin, size_t& end) {
+    // уровень сегмента - логарифм его размера в буферах по основанию MERGE_FACTOR
+    const auto tier = [](const IndexSegment& segment) {
+        size_t level = 0;
+        for(size_t size = segment.Span() / BUFFER_DOCUMENTS; size >= MERGE_FACTOR; size /= MERGE_FACTOR) {
+            ++level;
+        }
+        return level;
+    };
+    // более старые сегменты крупнее - ищем с конца
+    end = version.segments.size() - 1;
+    while(end > 0) {
+        const size_t level = tier(*version.segments[end - 1]);
+        begin = end - 1;
+        while(begin > 0 && tier(*version.segments[begin - 1]) == level) {
+            --begin;
+        }
+        if(end - begin >= MERGE_FACTOR) {
+            begin = end - MERGE_FACTOR;
+            return true;
+        }
+        end = begin;
+    }
+    // уплотнение переписывает сегмент без вхождений помеченных удалёнными документов
+    for(begin = 0; begin + 1 < version.segments.size(); ++begin) {
+        if(NeedsCompaction(*version.segments[begin])) {
+            end = begin + 1;
             return true;
         }
     }
     return false;
 }
+/**
+ * Цикл фонового слияния сегментов
+ */
+void SearchServer::RunMerges(SegmentState* state) {
+    unique_lock lock(state->mutex);
+    size_t begin = 0;
+    size_t end = 0;
+    while(true) {
+        state->merge_signal.wait(lock, [&]() {
+            return state->stopping || SelectMerge(*state->version, begin, end);
+        });
+        if(state->stopping) return;
+        // сливаемые сегменты закреплены и не меняются - блокировка на время слияния снимается
+        const auto& segments = state->version->segments;
+        const vector<shared_ptr<IndexSegment>> sources(segments.begin() + begin, segments.begin() + end);
+        lock.unlock();
+        auto merged = make_shared<IndexSegment>(IndexSegment::Merge(sources));
+        lock.lock();
+        // за время слияния новые сегменты могли только добавиться в конец,
+        // а удаление документа заменяет сегмент копией с новыми пометками - они переносятся в слитый
+        for(size_t i = 0; i < sources.size(); ++i) {
+            const IndexSegment& current = *state->version->segments[begin + i];
+            if(&current == sources[i].get()) continue;
+            sources[i]->LiveDocuments().ForEachInRange(current.FirstOrdinal(), current.EndOrdinal(), [&](uint32_t ordinal) {
+                if(!current.LiveDocuments().Contains(ordinal)) {
+                    merged->MarkRemoved(ordinal);
+                }
+            });
+        }
+        const shared_ptr<IndexVersion> draft = state->CopyVersion();
+        draft->segments.erase(draft->segments.begin() + begin + 1, draft->segments.begin() + end);
+        draft->segments[begin] = move(merged);
+        state->Publish(draft);
+    }
+}
+/**
+ * Рабочие буферы запросов текущего потока
+ */
+SearchServer::QueryContext& SearchServer::GetQueryContext() {
+    static thread_local QueryContext context;
+    return context;
+}
+/**
+ * Рабочие буферы диапазона многопоточного поиска текущего потока
+ */
+SearchServer::ShardScratch& SearchServer::GetShardScratch() {
+    static thread_local ShardScratch scratch;
+    return scratch;
+}
+/**
+ * Буфер границ слов текущего потока для разбора текста
+ */
+std::vector<StringProcessing::WordSpan>& SearchServer::GetWordSpans() {
+    static thread_local vector<StringProcessing::WordSpan> spans;
+    return spans;
+}
+/**
+ * Содержатся ли минус-слова в документе с внутренним номером
+ * Курсоры минус-слов только сдвигаются вперёд, поэтому документы
+ * проверяются по возрастанию номеров: исключение обходится как разность
+ * упорядоченных множеств с галопом по спискам минус-слов
+ */
+bool SearchServer::IsDocHasMinus(uint32_t ordinal, std::vector<PostingList::Cursor>& minus_cursors) {
+    for (PostingList::Cursor& cursor : minus_cursors) {
+        cursor.Seek(ordinal);
+        if(cursor.Document() == ordinal) {
+            return true;
+        }
+    }
+    return false;
+}
+/**
+ * Конструктор: пустой буферный сегмент
+ */
+SearchServer::SegmentState::SegmentState() :
+    version(make_shared<IndexVersion>()) {
+    version->segments.push_back(make_shared<IndexSegment>(0));
+    current.store(version.get());
+}
+/**
+ * Остановить фоновое слияние
+ */
+SearchServer::SegmentState::~SegmentState() {
+    {
+        lock_guard guard(mutex);
+        stopping = true;
+    }
+    merge_signal.notify_all();
+    if(merger.joinable()) {
+        merger.join();
+    }
+}
+/**
+ * Сегмент с номером index неопубликованной версии для изменения писателем
+ * Сегмент, общий с опубликованной версией, предварительно копируется
+ * Копия сегмента создана этим писателем и ещё никому не видна - повторные
+ * изменения в той же версии идут на месте
+ */
+IndexSegment& SearchServer::SegmentState::MutableSegment(IndexVersion& draft, size_t index) {
+    shared_ptr<IndexSegment>& segment = draft.segments[index];
+    if(segment.use_count() > 1) {
+        segment = make_shared<IndexSegment>(*segment);
+    }
+    return *segment;
+}
+/**
+ * Количества документов со словом в закрытых сегментах неопубликованной версии для изменения писателем
+ * Массив, общий с опубликованной версией, предварительно копируется
+ */
+PersistentArray<uint32_t>& SearchServer::SegmentState::MutableFrequencies(IndexVersion& draft) {
+    if(draft.sealed_frequencies.use_count() > 1) {
+        draft.sealed_frequencies = make_shared<PersistentArray<uint32_t>>(*draft.sealed_frequencies);
+    }
+    return *draft.sealed_frequencies;
+}
+/**
+ * Опубликовать новую версию индекса
+ * Прежняя версия освобождается, когда её дочитают все читатели
+ * Вызывается под блокировкой писателей
+ */
+void SearchServer::SegmentState::Publish(std::shared_ptr<IndexVersion> draft) {
+    current.store(draft.get());
+    epochs.Retire(exchange(version, move(draft)));
+    epochs.Reclaim();
+}
@@ -1,21 +1,48 @@
 #pragma once
-#include "concurrent_map.h"
 #include "string_processing.h"
 #include "document.h"
+#include "posting_list.h"
+#include "document_bitmap.h"
+#include "index_segment.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+#include "index_snapshot.h"
+#include "term_dictionary.h"
+#include "epoch_manager.h"
+#include "ordinal_table.h"
+#include "query_cache.h"
+#include "metrics.h"
+#include "executor.h"
 #include <string>
+#include <array>
 #include <set>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <tuple>
+#include <utility>
 #include <thread>
 #include <algorithm>
+#include <numeric>
 #include <execution>
+#include <type_traits>
+#include <limits>
+#include <optional>
 /**
  * Поисковой сервер
+ * Индекс разбит на сегменты: новые документы дописываются в буферный сегмент,
+ * закрытые сегменты сливаются в фоновом потоке.
+ * Запросы не берут блокировок: они закрепляют эпоху и читают опубликованную
+ * версию набора сегментов. Изменение публикует новую версию, которая делит
+ * с прежней всё, кроме затронутых списков вхождений и записей документов,
+ * а прежняя версия освобождается, когда её дочитают все запросы
  */
 class SearchServer {
 public:
     /**
-     * Максимальное число документов в выдаче
+     * Максимальное число документов в выдаче по умолчанию
      */
     static const int MAX_RESULT_DOCUMENT_COUNT = 5;
     /**
@@ -41,8 +68,33 @@ public:
 
     explicit SearchServer(std::string_view stop_words_text):
         SearchServer(StringProcessing::SplitIntoWordsView(stop_words_text)) { }
+    /**
+     * Слова документов ссылаются в арену словаря,
+     * поэтому сервер можно перемещать, но не копировать
+     * Перемещать сервер можно, только пока к нему нет обращений
+     */
+    SearchServer(const SearchServer&) = delete;
+    SearchServer(SearchServer&&) = default;
+    /**
+     * Открыть сервер из бинарного снимка
+     * Списки вхождений и прямой индекс читаются прямо из отображённого в память файла
+     * Сжатые блоки не распаковываются, а контрольная сумма не считается - это делает VerifySnapshot
+     */
+    static SearchServer OpenSnapshot(const std::string& path);
+    /**
+     * Проверить снимок целиком: контрольную сумму и порядок и границы
+     * номеров документов внутри сжатых блоков списков вхождений
+     * Читает весь файл, поэтому отделена от открытия снимка
+     */
+    static void VerifySnapshot(const std::string& path);
+    /**
+     * Сохранить индекс в бинарный снимок
+     * Внутренние номера документов при сохранении уплотняются
+     */
+    void SaveSnapshot(const std::string& path) const;
     /**
      * Начальный итератор загруженных id документов
+     * Обход не согласован с одновременными изменениями сервера
      */
     const std::set<int>::const_iterator begin() const noexcept;
     /**
@@ -56,40 +108,170 @@ public:
                      std::string_view document,
                      DocumentStatus status,
                      const std::vector<int>& ratings);
+    /**
+     * Документ для пакетного добавления
+     */
+    struct NewDocument {
+        /**
+         * Идентификатор документа
+         */
+        int id;
+        /**
+         * Содержимое документа
+         */
+        std::string_view text;
+        /**
+         * Статус документа
+         */
+        DocumentStatus status;
+        /**
+         * Оценки рейтинга
+         */
+        std::vector<int> ratings;
+    };
+    /**
+     * Добавить пакет новых документов
+     * Документы добавляются все или, при ошибке в любом из них, ни один
+     */
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    /**
+     * Добавить пакет новых документов
+     * Последовательная реализация
+     */
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+    /**
+     * Добавить пакет новых документов
+     * Многопоточная реализация: документы разбираются и индексируются параллельно
+     */
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
     /**
      * Найти документы, отсортированные по релевантности запросу
      * Вариант с политикой исполения поиска (однопоточная/многопоточная) и
      * функциональным объектом в качестве параметра
-     * Выводит максимум MAX_RESULT_DOCUMENT_COUNT документов
+     * Вместо политики можно передать исполнитель Executor
+     * Выводит максимум top_count документов
      */
     template<typename ExecutionPolicy, typename Functor>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy,
                                            std::string_view raw_query,
-                                           Functor functor) const;
+                                           Functor functor,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
     /**
      * Найти документы, отсортированные по релевантности запросу
      * Вариант с функциональным объектом в качестве параметра
-     * Выводит максимум MAX_RESULT_DOCUMENT_COUNT документов
+     * Выводит максимум top_count документов
      */
     template <typename Functor>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, Functor functor) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           Functor functor,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
     /**
      * Найти документы, отсортированные по релевантности запросу
      * Вариант с политикой исполения поиска в качестве параметра и
      * статуса документа
-     * Выводит максимум MAX_RESULT_DOCUMENT_COUNT документов
+     * Вместо политики можно передать исполнитель Executor
+     * Выводит максимум top_count документов
      */
     template<typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy,
                                            std::string_view raw_query,
-                                           DocumentStatus input_status = DocumentStatus::ACTUAL) const;
+                                           DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
     /**
     * Найти документы, отсортированные по релевантности запросу
     * Вариант со статусом документа в качестве параметра
-    * Выводит максимум MAX_RESULT_DOCUMENT_COUNT документов
+    * Выводит максимум top_count документов
     */
     std::vector<Document> FindTopDocuments(std::string_view raw_query,
-                                           DocumentStatus input_status = DocumentStatus::ACTUAL) const;
+                                           DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    /**
+     * Найти документы, следующие в порядке выдачи за документом after (search-after)
+     * Продолжает выдачу с последнего документа предыдущей страницы:
+     * отбирается только top_count документов, сколько бы страниц ни было пройдено
+     */
+    std::vector<Document> FindTopDocumentsAfter(std::string_view raw_query,
+                                                const Document& after,
+                                                DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                                size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    /**
+     * Рабочие буферы запроса: разбор, слова, расчёт релевантности и выдача
+     * Контекст переиспользуется между запросами одного потока,
+     * поэтому поиск с ним после прогрева не выделяет память
+     */
+    class QueryContext;
+    /**
+     * Найти документы, отсортированные по релевантности запросу
+     * Вариант с рабочими буферами вызывающего и функциональным объектом в качестве параметра
+     * Выдача хранится в контексте до следующего запроса с ним
+     */
+    template <typename Functor>
+    const std::vector<Document>& FindTopDocuments(QueryContext& context,
+                                                  std::string_view raw_query,
+                                                  Functor functor,
+                                                  size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    /**
+     * Найти документы, отсортированные по релевантности запросу
+     * Вариант с рабочими буферами вызывающего и статусом документа в качестве параметра
+     * Выдача хранится в контексте до следующего запроса с ним
+     */
+    const std::vector<Document>& FindTopDocuments(QueryContext& context,
+                                                  std::string_view raw_query,
+                                                  DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                                  size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    /**
+     * Найти документы, отсортированные по релевантности запросу
+     * Вариант с рабочими буферами вызывающего, статусом документа и прерыванием:
+     * interrupt() вызывается на каждом окне номеров документов
+     * и может прервать поиск исключением, которое получит вызывающий
+     * Выдача хранится в контексте до следующего запроса с ним
+     */
+    template <typename Interrupt>
+    const std::vector<Document>& FindTopDocuments(QueryContext& context,
+                                                  std::string_view raw_query,
+                                                  DocumentStatus input_status,
+                                                  size_t top_count,
+                                                  Interrupt interrupt) const;
+    /**
+     * Найти документы для пакета запросов
+     * Общие слова запросов ищутся в словаре один раз,
+     * запросы выполняются параллельно на рабочих буферах потоков
+     * Для каждого запроса выводит максимум top_count документов
+     */
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+                                                             DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                                             size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    /**
+     * Найти документы для пакета запросов
+     * Запросы выполняются на потоках исполнителя,
+     * небольшой пакет выполняется последовательно
+     * Для каждого запроса выводит максимум top_count документов
+     */
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const Executor& executor,
+                                                             const std::vector<std::string>& raw_queries,
+                                                             DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                                             size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    /**
+     * Найти документы для пакета запросов и сложить выдачи подряд в documents
+     * offsets - смещения начала выдачи каждого запроса,
+     * последний элемент - общее количество документов
+     * Запросы выполняются параллельно на рабочих буферах потоков
+     */
+    void FindTopDocumentsBatchJoined(const std::vector<std::string>& raw_queries,
+                                     std::vector<Document>& documents,
+                                     std::vector<size_t>& offsets,
+                                     DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    /**
+     * Найти документы для пакета запросов и сложить выдачи подряд в documents
+     * Запросы выполняются на потоках исполнителя
+     */
+    void FindTopDocumentsBatchJoined(const Executor& executor,
+                                     const std::vector<std::string>& raw_queries,
+                                     std::vector<Document>& documents,
+                                     std::vector<size_t>& offsets,
+                                     DocumentStatus input_status = DocumentStatus::ACTUAL,
+                                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
     /**
      * Количество загруженных документов
      */
@@ -113,6 +295,13 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&,
                                                                        std::string_view raw_query,
                                                                        int document_id) const;
+    /**
+     * Совпадающие слова в запросе к конкретному документу и статус документа.
+     * Реализация на потоках исполнителя, короткий запрос проверяется последовательно
+     */
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const Executor& executor,
+                                                                       std::string_view raw_query,
+                                                                       int document_id) const;
     /**
      * Получить text frequency слов по id документа
      */
@@ -121,8 +310,15 @@ public:
      * Получить уникальные слова документа
      */
     const std::vector<std::string_view> GetUniqueWords(int document_id) const;
+    /**
+     * Получить идентификаторы слов документа по возрастанию
+     * Идентификаторы назначает словарь сервера, у одинаковых слов разных документов они совпадают
+     */
+    std::vector<uint32_t> GetDocumentTerms(int document_id) const;
     /**
      * Удалить документ по его id
+     * Документ закрытого сегмента только помечается удалённым,
+     * его вхождения вычищает фоновое слияние или уплотнение сегмента
      */
     void RemoveDocument(int document_id);
     /**
@@ -132,9 +328,33 @@ public:
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     /**
      * Удалить документ по его id
-     * Многопоточная реализация
+     * Многопоточная реализация: пометка удалённым не требует параллельного вычищения
      */
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+    /**
+     * Удалить документ по его id
+     * Вариант с исполнителем: пометка удалённым выполняется в вызывающем потоке
+     */
+    void RemoveDocument(const Executor& executor, int document_id);
+    /**
+     * Удалить документы по их id
+     * Все документы удаляются одной новой версией индекса
+     */
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    /**
+     * Объём сжатых списков вхождений в байтах
+     */
+    size_t GetPostingsMemoryUsage() const;
+    /**
+     * Включить кэш результатов поиска по статусу объёмом не больше byte_budget байт
+     * Нулевой бюджет выключает кэш
+     * Вызывается, пока к серверу нет обращений
+     */
+    void SetQueryCache(size_t byte_budget, size_t shard_count = QueryCache::DEFAULT_SHARD_COUNT);
+    /**
+     * Счётчики кэша результатов поиска, нулевые при выключенном кэше
+     */
+    QueryCache::Stats GetQueryCacheStats() const;
 private:
     /**
      * Слово из запроса
@@ -167,35 +387,299 @@ private:
         std::vector<std::string_view> words_minus;
     };
     /**
-     * Измерения для слов загруженных документов
-     * Содержит id документов, где они встречаются и text frequency
+     * Слово запроса, найденное в словаре
      */
-    std::map<std::string, std::map<int, double>> words_measures_;
+    struct ResolvedWord {
+        /**
+         * Идентификатор слова или NOT_FOUND, если слово не встречается в документах
+         */
+        uint32_t term = TermDictionary::NOT_FOUND;
+        /**
+         * IDF слова
+         */
+        double idf = 0;
+    };
     /**
-     * Измерения для загруженных документов
-     * По id документа содержит слова и их text frequency
+     * Плюс-слово запроса с весом, общим для всех сегментов
      */
-    std::map<int, std::map<std::string_view, double>> document_measures_;
+    struct ResolvedTerm {
+        /**
+         * Идентификатор слова
+         */
+        uint32_t term;
+        /**
+         * IDF слова, умноженный на число его повторов в запросе
+         */
+        double weight;
+    };
     /**
-     * Известные стоп-слова
+     * Запрос, слова которого найдены в словаре
+     * IDF считается по всем сегментам одной версии индекса
      */
-    const std::set<std::string, std::less<>> stop_words_;
+    struct ResolvedQuery {
+        /**
+         * Плюс-слова без повторов по возрастанию идентификаторов:
+         * в этом порядке суммируются вклады слов в релевантность
+         */
+        std::vector<ResolvedTerm> terms_plus;
+        /**
+         * Идентификаторы минус-слов
+         */
+        std::vector<uint32_t> terms_minus;
+    };
     /**
-     * Количество загруженных документов
+     * Плюс-слово запроса, подготовленное к расчёту релевантности в сегменте
+     */
+    struct QueryTerm {
+        /**
+         * Список вхождений слова
+         */
+        const PostingList* postings;
+        /**
+         * IDF слова, умноженный на число его повторов в запросе
+         */
+        double weight;
+        /**
+         * Оценка сверху вклада слова в релевантность любого документа
+         */
+        double upper_bound;
+    };
+    /**
+     * Запрос, подготовленный к выполнению в сегменте
+     */
+    struct PreparedQuery {
+        /**
+         * Плюс-слова по возрастанию оценки сверху
+         */
+        std::vector<QueryTerm> terms_plus;
+        /**
+         * Плюс-слова, встречающиеся в сегменте, по возрастанию идентификаторов
+         */
+        std::vector<ResolvedTerm> terms_by_id;
+        /**
+         * Списки вхождений минус-слов
+         */
+        std::vector<const PostingList*> postings_minus;
+    };
+    /**
+     * Рабочие буферы расчёта релевантности
+     * У каждого потока свои, переиспользуются между запросами
+     */
+    struct ScoringScratch {
+        /**
+         * Курсоры списков вхождений плюс-слов
+         */
+        std::vector<PostingList::Cursor> cursors;
+        /**
+         * Курсоры списков вхождений минус-слов
+         */
+        std::vector<PostingList::Cursor> minus_cursors;
+        /**
+         * Накопленные оценки сверху вклада плюс-слов
+         */
+        std::vector<double> bounds;
+        /**
+         * Релевантность документов текущего окна
+         */
+        std::vector<double> window_relevances;
+        /**
+         * Отметки документов текущего окна
+         */
+        std::vector<uint8_t> window_touched;
+    };
+    /**
+     * Поиск без прерывания
+     */
+    struct NoInterrupt {
+        void operator()() const noexcept { }
+    };
+    /**
+     * Рабочие буферы диапазона многопоточного поиска
+     * У каждого потока свои, переиспользуются между диапазонами и запросами
+     */
+    struct ShardScratch {
+        /**
+         * Релевантность документов диапазона
+         */
+        ScoreAccumulator accumulator;
+        /**
+         * Выдача диапазона
+         */
+        TopDocuments top_documents{0};
+    };
+    /**
+     * Допуск при сравнении оценки сверху релевантности с порогом выдачи
+     * Покрывает погрешность суммирования в другом порядке
+     */
+    static constexpr double RELEVANCE_BOUND_SLACK = 1e-9;
+    /**
+     * Размер окна номеров документов, по которому накапливается релевантность
+     * при отсечении по MaxScore
+     */
+    static constexpr uint32_t SCORING_WINDOW_SIZE = 4096;
+    /**
+     * Наименьший диапазон номеров документов, который многопоточный поиск
+     * отдаёт отдельному потоку
+     */
+    static constexpr size_t MIN_SHARD_SPAN = 1024;
+    /**
+     * Количество документов, при котором буферный сегмент закрывается для записи
+     */
+    static constexpr size_t BUFFER_DOCUMENTS = 4096;
+    /**
+     * Количество сегментов одного уровня, сливаемых в сегмент следующего уровня
+     */
+    static constexpr size_t MERGE_FACTOR = 4;
+    /**
+     * Закрытый сегмент уплотняется, когда помеченные удалёнными документы
+     * составляют не меньше 1 / COMPACTION_RATIO его документов с вхождениями
+     */
+    static constexpr size_t COMPACTION_RATIO = 4;
+    /**
+     * Версия индекса: набор сегментов, видимый запросу целиком
+     */
+    struct IndexVersion {
+        /**
+         * Сегменты по возрастанию внутренних номеров
+         * Последний - буферный сегмент, куда дописываются новые документы
+         */
+        std::vector<std::shared_ptr<IndexSegment>> segments;
+        /**
+         * Количество неудалённых документов во всех сегментах
+         */
+        size_t document_count = 0;
+        /**
+         * Поколение документов: растёт при каждом добавлении и удалении документов
+         * Слияние сегментов результаты поиска не меняет и поколение не наращивает
+         */
+        uint64_t generation = 0;
+        /**
+         * Количество документов со словом в закрытых сегментах по идентификатору слова
+         * Пересчитывается пакетом при закрытии сегмента и при удалении документа
+         * из закрытого сегмента - запрос добавляет к нему только вхождения буферного сегмента
+         * Слияние сегментов количество не меняет
+         */
+        std::shared_ptr<PersistentArray<uint32_t>> sealed_frequencies = std::make_shared<PersistentArray<uint32_t>>();
+    };
+    /**
+     * Общее состояние сегментов сервера, их публикации и фонового слияния
+     * Хранится отдельно, чтобы поток слияния и читатели не зависели от перемещения сервера
+     */
+    struct SegmentState {
+        SegmentState();
+        /**
+         * Остановить фоновое слияние
+         */
+        ~SegmentState();
+        /**
+         * Опубликованная версия индекса
+         * Читатель обращается к ней только с закреплённой эпохой
+         */
+        const IndexVersion& Current() const {
+            return *current.load();
+        }
+        /**
+         * Копия опубликованной версии для изменения писателем
+         * Копия делит с опубликованной версией все сегменты
+         */
+        std::shared_ptr<IndexVersion> CopyVersion() const {
+            return std::make_shared<IndexVersion>(*version);
+        }
+        /**
+         * Сегмент с номером index неопубликованной версии для изменения писателем
+         * Сегмент, общий с опубликованной версией, предварительно копируется
+         */
+        static IndexSegment& MutableSegment(IndexVersion& draft, size_t index);
+        /**
+         * Количества документов со словом в закрытых сегментах неопубликованной версии для изменения писателем
+         * Массив, общий с опубликованной версией, предварительно копируется
+         */
+        static PersistentArray<uint32_t>& MutableFrequencies(IndexVersion& draft);
+        /**
+         * Опубликовать новую версию индекса
+         * Прежняя версия освобождается, когда её дочитают все читатели
+         * Вызывается под блокировкой писателей
+         */
+        void Publish(std::shared_ptr<IndexVersion> draft);
+        /**
+         * Блокировка писателей: изменения документов и установка слитых сегментов
+         * Читатели её не берут
+         */
+        std::mutex mutex;
+        /**
+         * Сигнал о появлении сегментов для слияния или об остановке
+         */
+        std::condition_variable merge_signal;
+        /**
+         * Эпохи читателей и освобождение снятых с публикации данных
+         */
+        EpochManager epochs;
+        /**
+         * Опубликованная версия индекса во владении писателя
+         */
+        std::shared_ptr<IndexVersion> version;
+        /**
+         * Опубликованная версия индекса для читателей
+         */
+        std::atomic<const IndexVersion*> current{nullptr};
+        /**
+         * Внутренние номера загруженных документов по их id
+         */
+        OrdinalTable ordinals{epochs};
+        /**
+         * Запрошена ли остановка фонового слияния
+         */
+        bool stopping = false;
+        /**
+         * Поток фонового слияния, запускается при закрытии первого буфера
+         */
+        std::thread merger;
+    };
+    /**
+     * Text frequency слов документов по id, собранные для GetWordFrequencies
+     * Строятся по прямому индексу при первом обращении
+     */
+    struct WordFrequenciesCache {
+        std::mutex mutex;
+        std::map<int, std::map<std::string_view, double>> documents;
+    };
+    /**
+     * Словарь: идентификаторы слов и их единственные копии
+     */
+    TermDictionary terms_;
+    /**
+     * Сегменты индекса и их фоновое слияние
+     */
+    std::unique_ptr<SegmentState> segments_ = std::make_unique<SegmentState>();
+    /**
+     * Собранные text frequency слов документов по id
+     */
+    std::unique_ptr<WordFrequenciesCache> word_frequencies_ = std::make_unique<WordFrequenciesCache>();
+    /**
+     * Кэш результатов поиска по статусу или nullptr, если кэш выключен
+     */
+    std::unique_ptr<QueryCache> query_cache_;
+    /**
+     * Известные стоп-слова
      */
-    std::map<int, DocumentData> documents_;
+    const std::set<std::string, std::less<>> stop_words_;
     /**
      * Идентификаторы добавленных документов
      */
     std::set<int> document_ids_;
+    /**
+     * Снимок, на который ссылаются списки вхождений открытого из него сервера
+     */
+    std::shared_ptr<const MappedFile> snapshot_file_;
     /**
      * Является ли слово стоп-словом
      */
     bool IsStopWord(std::string_view word) const;
     /**
      * Разложить входной текст в вектор из слов, исключая известные стоп-слова
+     * Возвращает false, если текст содержит недопустимый символ
      */
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    bool SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view>& words) const;
     /**
      * Получить слово запроса из текста
      */
@@ -206,27 +690,266 @@ private:
      */
     Query ParseQuery(std::string_view text, bool need_unique = false) const;
     /**
-     * Вычислить IDF для слова
+     * Получить структурированный запрос из текста в query
+     * Границы слов размечаются в spans, память query и spans переиспользуется
+     */
+    void ParseQuery(std::string_view text,
+                    bool need_unique,
+                    Query& query,
+                    std::vector<StringProcessing::WordSpan>& spans) const;
+    /**
+     * Содержит ли документ слово с идентификатором
+     */
+    static bool HasTerm(const IndexSegment::DocumentRecord& document, uint32_t term);
+    /**
+     * Номер сегмента версии, содержащего внутренний номер документа
+     */
+    static size_t FindSegment(const IndexVersion& version, uint32_t ordinal);
+    /**
+     * Неудалённый документ версии по id или nullptr
+     * Вызывается с закреплённой эпохой
+     */
+    const IndexSegment::DocumentRecord* FindDocument(const IndexVersion& version, int document_id) const;
+    /**
+     * Вычислить IDF для слова по числу содержащих его документов
+     */
+    static double CalcIdf(size_t document_frequency, size_t document_count);
+    /**
+     * Вычислить релевантность документа по его прямому индексу
+     * Вклады слов суммируются по возрастанию идентификаторов, как и при
+     * параллельном поиске, поэтому релевантность не зависит от способа поиска
+     */
+    static double CalcRelevance(const IndexSegment::DocumentRecord& document, const std::vector<ResolvedTerm>& terms);
+    /**
+     * Найти слово в словаре и вычислить его IDF по версии
+     * Вызывается с закреплённой эпохой
+     */
+    ResolvedWord ResolveWord(std::string_view word, const IndexVersion& version) const;
+    /**
+     * Найти слова запроса в словаре функциональным объектом resolve
+     * Повторы плюс-слова объединяются, слова без вхождений отбрасываются
+     * words - буфер для сортировки плюс-слов
+     */
+    template<typename Resolver>
+    static void ResolveQuery(const Query& query,
+                             Resolver resolve,
+                             std::vector<std::string_view>& words,
+                             ResolvedQuery& resolved);
+    /**
+     * Подготовить запрос к выполнению в сегменте
+     * Слова без вхождений в сегмент отбрасываются
+     */
+    static void PrepareQuery(const ResolvedQuery& query, const IndexSegment& segment, PreparedQuery& prepared);
+    /**
+     * Оценка стоимости поиска в сегменте: количество вхождений слов запроса
+     */
+    static size_t QueryCost(const ResolvedQuery& query, const IndexSegment& segment);
+    /**
+     * Добавить пакет новых документов с политикой исполнения
+     */
+    template <typename ExecutionPolicy>
+    void AddDocumentsIn(ExecutionPolicy policy, const std::vector<NewDocument>& documents);
+    /**
+     * Найти документы для пакета запросов с политикой исполнения
+     */
+    template <typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatchIn(const ExecutionPolicy& policy,
+                                                               const std::vector<std::string>& raw_queries,
+                                                               DocumentStatus input_status,
+                                                               size_t top_count) const;
+    /**
+     * Найти документы для пакета запросов с политикой исполнения
+     * и сложить выдачи подряд в documents
+     */
+    template <typename ExecutionPolicy>
+    void FindTopDocumentsBatchJoinedIn(const ExecutionPolicy& policy,
+                                       const std::vector<std::string>& raw_queries,
+                                       std::vector<Document>& documents,
+                                       std::vector<size_t>& offsets,
+                                       DocumentStatus input_status,
+                                       size_t top_count) const;
+    /**
+     * Выполнить пакет запросов с политикой исполнения
+     * До запуска вызывается reserve(количество запросов, наибольший размер выдачи),
+     * выдача каждого запроса передаётся в store(номер запроса, выдача)
+     */
+    template <typename ExecutionPolicy, typename Reserve, typename Store>
+    void RunQueryBatch(const ExecutionPolicy& policy,
+                       const std::vector<std::string>& raw_queries,
+                       DocumentStatus input_status,
+                       size_t top_count,
+                       Reserve reserve,
+                       Store store) const;
+    /**
+     * Разбудить поток слияния, запустив его при первом закрытом сегменте
+     * Вызывается под блокировкой писателей
+     */
+    void SignalMerger();
+    /**
+     * Закрыть буферный сегмент неопубликованной версии и начать новый
+     * Вызывается под блокировкой писателей
+     */
+    static void SealBuffer(IndexVersion& draft);
+    /**
+     * Список вхождений слова снимка по номеру в словаре снимка
+     * Проверяет границы списка и заголовки его блоков, не распаковывая их
+     */
+    static PostingList SnapshotPostings(const IndexSnapshot& snapshot, size_t index);
+    /**
+     * Учесть слова закрытого сегмента в количествах документов со словом
+     */
+    static void CountSealedTerms(IndexVersion& draft, const IndexSegment& segment);
+    /**
+     * Исключить слова документа, удаляемого из сегмента с номером index,
+     * из количеств документов со словом, если сегмент закрыт
+     */
+    static void UncountSealedDocument(IndexVersion& draft, size_t index, uint32_t ordinal);
+    /**
+     * Удалить документы с внутренними номерами по возрастанию из неопубликованной версии
+     * Документы закрытых сегментов помечаются удалёнными, буферного - вычищаются сразу
+     * Возвращает true, если какой-то из затронутых сегментов пора уплотнить
+     */
+    static bool RemoveOrdinals(IndexVersion& draft, const std::vector<uint32_t>& ordinals);
+    /**
+     * Пора ли уплотнить закрытый сегмент
+     */
+    static bool NeedsCompaction(const IndexSegment& segment);
+    /**
+     * Найти подряд идущие сегменты одного уровня для слияния [begin, end)
+     * или один сегмент для уплотнения
+     * Буферный сегмент не сливается
+     */
+    static bool SelectMerge(const IndexVersion& version, size_t& begin, size_t& end);
+    /**
+     * Цикл фонового слияния сегментов
+     */
+    static void RunMerges(SegmentState* state);
+    /**
+     * Рабочие буферы запросов текущего потока
      */
-    double CalcIdf(std::string_view word) const;
+    static QueryContext& GetQueryContext();
     /**
-     * Содержатся ли минус-слова в документе
+     * Рабочие буферы диапазона многопоточного поиска текущего потока
      */
-    bool IsDocHasMinus(const std::pair<int, double>& doc,
-                       const std::vector<std::string_view> &words_minus) const;
+    static ShardScratch& GetShardScratch();
     /**
-     * Найти все документы, соответствующие запросу
+     * Буфер границ слов текущего потока для разбора текста
+     */
+    static std::vector<StringProcessing::WordSpan>& GetWordSpans();
+    /**
+     * Содержатся ли минус-слова в документе с внутренним номером
+     * Курсоры минус-слов только сдвигаются вперёд, поэтому документы
+     * проверяются по возрастанию номеров: исключение обходится как разность
+     * упорядоченных множеств с галопом по спискам минус-слов
+     */
+    static bool IsDocHasMinus(uint32_t ordinal, std::vector<PostingList::Cursor>& minus_cursors);
+    /**
+     * Найти все документы сегмента, соответствующие запросу, и передать их в выдачу
      * Для документов также расчитывается TF-IDF
+     * Обход документов окнами по возрастанию номеров с отсечением по MaxScore:
+     * слова, которые уже не могут поднять документ в выдачу, только досчитываются
+     * Порог отсечения начинается с худшего документа уже заполненной выдачи
+     * interrupt() вызывается перед каждым окном
      */
-    template<typename Functor>
-    std::vector<Document> FindAllDocuments(const Query& query, Functor functor) const;
+    template<typename Filter, typename Interrupt = NoInterrupt>
+    static void FindAllDocuments(const IndexSegment& segment,
+                                 const PreparedQuery& query,
+                                 const DocumentBitmap& candidates,
+                                 Filter filter,
+                                 TopDocuments& top_documents,
+                                 ScoringScratch& scratch,
+                                 Interrupt interrupt = Interrupt());
     /**
-     * Найти все документы, соответствующие запросу
-     * Многопоточная реализация
+     * Найти все документы сегмента, соответствующие запросу, и передать их в выдачу
+     * Многопоточная реализация: номера документов сегмента делятся на диапазоны,
+     * поток считает все слова запроса по своему диапазону и набирает свою выдачу,
+     * затем выдачи диапазонов сливаются
      * Для документов также расчитывается TF-IDF
+     * interrupt() вызывается перед каждым диапазоном
      */
-    template<typename ExecutionPolicy, typename Functor>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy policy, const Query& query, Functor functor) const;
+    template<typename ExecutionPolicy, typename Filter, typename Interrupt = NoInterrupt>
+    static void FindAllDocuments(ExecutionPolicy policy,
+                                 const IndexSegment& segment,
+                                 const ResolvedQuery& query,
+                                 const DocumentBitmap& candidates,
+                                 Filter filter,
+                                 TopDocuments& top_documents,
+                                 Interrupt interrupt = Interrupt());
+    /**
+     * Найти документы, отсортированные по релевантности запросу
+     * В каждом сегменте обходятся документы из множества candidates(segment),
+     * прошедшие фильтр по записи документа
+     * Множество проверяется первым и дёшево, фильтр - только для сильных кандидатов
+     * Поиск по статусу cache_status идёт через кэш результатов, если тот включён
+     * Если задан документ after, отбираются только следующие за ним в порядке выдачи
+     * interrupt() вызывается на каждом окне и диапазоне номеров документов
+     * и может прервать поиск исключением
+     */
+    template<typename ExecutionPolicy, typename Candidates, typename Filter, typename Interrupt = NoInterrupt>
+    void FindTopDocumentsIn(ExecutionPolicy policy,
+                            QueryContext& context,
+                            std::string_view raw_query,
+                            Candidates candidates,
+                            Filter filter,
+                            size_t top_count,
+                            std::optional<DocumentStatus> cache_status = std::nullopt,
+                            const std::optional<Document>& after = std::nullopt,
+                            Interrupt interrupt = Interrupt()) const;
+    /**
+     * Ключ кэша результатов: плюс-слова запроса по порядку с повторами,
+     * минус-слова по порядку без повторов, статус и размер выдачи
+     * words - буфер для сортировки слов
+     */
+    static void MakeCacheKey(const Query& query,
+                             DocumentStatus status,
+                             size_t top_count,
+                             std::vector<std::string_view>& words,
+                             std::string& key);
+};
+/**
+ * Рабочие буферы запроса: разбор, слова, расчёт релевантности и выдача
+ * Контекст переиспользуется между запросами одного потока,
+ * поэтому поиск с ним после прогрева не выделяет память
+ */
+class SearchServer::QueryContext {
+private:
+    friend class SearchServer;
+    /**
+     * Границы слов текста запроса
+     */
+    std::vector<StringProcessing::WordSpan> spans;
+    /**
+     * Структурированный запрос
+     */
+    Query query;
+    /**
+     * Плюс-слова, отсортированные для объединения повторов
+     */
+    std::vector<std::string_view> words;
+    /**
+     * Запрос, слова которого найдены в словаре
+     */
+    ResolvedQuery resolved;
+    /**
+     * Запрос, подготовленный к выполнению в текущем сегменте
+     */
+    PreparedQuery prepared;
+    /**
+     * Рабочие буферы расчёта релевантности
+     */
+    ScoringScratch scoring;
+    /**
+     * Отбор лучших документов
+     */
+    TopDocuments top_documents{0};
+    /**
+     * Выдача последнего запроса
+     */
+    std::vector<Document> documents;
+    /**
+     * Ключ запроса в кэше результатов
+     */
+    std::string cache_key;
 };
 
 template <typename StringContainer>
@@ -234,92 +957,349 @@ SearchServer::SearchServer(const StringContainer& stop_words):
     stop_words_(StringProcessing::ToNonEmptySet(stop_words)) { }
 
 template<typename ExecutionPolicy, typename Functor>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, Functor functor) const {
-    const Query& query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, functor);
-    sort(matched_documents.begin(), matched_documents.end());
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy,
+                                                     std::string_view raw_query,
+                                                     Functor functor,
+                                                     size_t top_count) const {
+    QueryContext& context = GetQueryContext();
+    FindTopDocumentsIn(policy,
+                       context,
+                       raw_query,
+                       [](const IndexSegment& segment) -> const DocumentBitmap& {
+        return segment.LiveDocuments();
+    },
+                       [&functor](const IndexSegment::DocumentRecord& document) {
+        return functor(document.id, document.data.status, document.data.rating);
+    },
+                       top_count);
+    return context.documents;
 }
 
 template <typename Functor>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, Functor functor) const {
-    return FindTopDocuments(std::execution::seq, raw_query, functor);
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context,
+                                                            std::string_view raw_query,
+                                                            Functor functor,
+                                                            size_t top_count) const {
+    FindTopDocumentsIn(std::execution::seq,
+                       context,
+                       raw_query,
+                       [](const IndexSegment& segment) -> const DocumentBitmap& {
+        return segment.LiveDocuments();
+    },
+                       [&functor](const IndexSegment::DocumentRecord& document) {
+        return functor(document.id, document.data.status, document.data.rating);
+    },
+                       top_count);
+    return context.documents;
+}
+
+template <typename Functor>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+                                                     Functor functor,
+                                                     size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, functor, top_count);
 }
 
 template<typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy,
                                        std::string_view raw_query,
-                                       DocumentStatus input_status) const {
-    return FindTopDocuments(policy,
-                            raw_query,
-                            [input_status](int, DocumentStatus status, int) {
-        return status == input_status;
-    });
+                                       DocumentStatus input_status,
+                                       size_t top_count) const {
+    // статус проверяется по множеству документов, без обращения к самим документам
+    QueryContext& context = GetQueryContext();
+    FindTopDocumentsIn(policy,
+                       context,
+                       raw_query,
+                       [input_status](const IndexSegment& segment) -> const DocumentBitmap& {
+        return segment.StatusDocuments(input_status);
+    },
+                       [](const IndexSegment::DocumentRecord&) { return true; },
+                       top_count,
+                       input_status);
+    return context.documents;
 }
 
-template<typename Functor>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Functor functor) const {
-    std::map<int, double> relevances;
-    for (const auto word_plus : query.words_plus) {
-        const auto word_it = words_measures_.find(std::string(word_plus));
-        if(word_it == words_measures_.cend()) continue;
-        const double idf = CalcIdf(word_plus);
-        for(const auto [doc_id, tf] : word_it->second) {
-            const DocumentData &doc_data = documents_.at(doc_id);
-            if(!functor(doc_id, doc_data.status, doc_data.rating)) {
-                continue;
-            }
-            relevances[doc_id] += tf * idf;
+template <typename Interrupt>
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context,
+                                                            std::string_view raw_query,
+                                                            DocumentStatus input_status,
+                                                            size_t top_count,
+                                                            Interrupt interrupt) const {
+    FindTopDocumentsIn(std::execution::seq,
+                       context,
+                       raw_query,
+                       [input_status](const IndexSegment& segment) -> const DocumentBitmap& {
+        return segment.StatusDocuments(input_status);
+    },
+                       [](const IndexSegment::DocumentRecord&) { return true; },
+                       top_count,
+                       input_status,
+                       std::nullopt,
+                       interrupt);
+    return context.documents;
+}
+
+template<typename ExecutionPolicy, typename Candidates, typename Filter, typename Interrupt>
+void SearchServer::FindTopDocumentsIn(ExecutionPolicy policy,
+                                      QueryContext& context,
+                                      std::string_view raw_query,
+                                      Candidates candidates,
+                                      Filter filter,
+                                      size_t top_count,
+                                      std::optional<DocumentStatus> cache_status,
+                                      const std::optional<Document>& after,
+                                      Interrupt interrupt) const {
+    METRICS_TIMER("query");
+    {
+        METRICS_TIMER("query.parse");
+        ParseQuery(raw_query, false, context.query, context.spans);
+    }
+    // версия индекса закреплена эпохой до конца запроса - писатели её не меняют
+    const auto guard = segments_->epochs.Pin();
+    const IndexVersion& version = segments_->Current();
+    QueryCache* const cache = cache_status ? query_cache_.get() : nullptr;
+    if (cache != nullptr) {
+        MakeCacheKey(context.query, *cache_status, top_count, context.words, context.cache_key);
+        if (cache->Find(context.cache_key, version.generation, context.documents)) {
+            return;
         }
     }
-    std::vector<Document> matched_documents;
-    for (const auto& [doc_id, relevance] : relevances) {
-        if(IsDocHasMinus({doc_id, relevance}, query.words_minus)) {
-            continue;
+    {
+        METRICS_TIMER("query.postings");
+        ResolveQuery(context.query,
+                     [this, &version](std::string_view word) {
+            return ResolveWord(word, version);
+        },
+                     context.words,
+                     context.resolved);
+    }
+    // в выдачу не попадёт больше документов, чем есть в индексе
+    TopDocuments& top_documents = context.top_documents;
+    top_documents.Reset(std::min(top_count, version.document_count), after);
+    for (const auto& segment : version.segments) {
+        // исполнитель выполняет дешёвый поиск последовательно
+        bool sequential = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>;
+        if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, Executor>) {
+            sequential = policy.Parallelism(QueryCost(context.resolved, *segment)) <= 1;
+        }
+        if (sequential) {
+            {
+                METRICS_TIMER("query.postings");
+                PrepareQuery(context.resolved, *segment, context.prepared);
+            }
+            METRICS_TIMER("query.scoring");
+            FindAllDocuments(*segment,
+                             context.prepared,
+                             candidates(*segment),
+                             filter,
+                             top_documents,
+                             context.scoring,
+                             interrupt);
+        } else {
+            METRICS_TIMER("query.scoring");
+            FindAllDocuments(policy, *segment, context.resolved, candidates(*segment), filter, top_documents, interrupt);
         }
-        matched_documents.push_back({doc_id, relevance, documents_.at(doc_id).rating});
     }
-    return matched_documents;
+    {
+        METRICS_TIMER("query.top_k");
+        top_documents.Extract(context.documents);
+    }
+    if (cache != nullptr) {
+        cache->Insert(context.cache_key, version.generation, context.documents);
+    }
 }
 
-template<typename ExecutionPolicy, typename Functor>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, const Query& query, Functor functor) const {
-    using namespace std::execution;
-//    // определяем доступное число потоков
-//    const auto thread_count = static_cast<int>(std::thread::hardware_concurrency());
-    ConcurrentMap<int, double> relevances(16);
-    // Многопоточный расчёт релевантности документов
-    std::for_each(policy,
-                  query.words_plus.begin(), query.words_plus.end(),
-                  [this, &functor, &relevances](std::string_view word) {
-        const auto word_it = words_measures_.find(std::string(word));
-        if(word_it == words_measures_.cend()) return;
-        const double idf = CalcIdf(word);
-        for (const auto [doc_id, tf] : word_it->second) {
-            const auto& [rating, status] = documents_.at(doc_id);
-            if (!functor(doc_id, status, rating)) continue;
-            relevances[doc_id].ref_to_value += tf * idf;
+template<typename Resolver>
+void SearchServer::ResolveQuery(const Query& query,
+                                Resolver resolve,
+                                std::vector<std::string_view>& words,
+                                ResolvedQuery& resolved) {
+    resolved.terms_plus.clear();
+    resolved.terms_minus.clear();
+    words.assign(query.words_plus.begin(), query.words_plus.end());
+    std::sort(words.begin(), words.end());
+    for (auto it = words.begin(); it != words.end();) {
+        const auto last = std::upper_bound(it, words.end(), *it);
+        const ResolvedWord word = resolve(*it);
+        if (word.term != TermDictionary::NOT_FOUND) {
+            resolved.terms_plus.push_back({word.term, word.idf * (last - it)});
         }
+        it = last;
+    }
+    std::sort(resolved.terms_plus.begin(), resolved.terms_plus.end(), [](const ResolvedTerm& lhs, const ResolvedTerm& rhs) {
+        return lhs.term < rhs.term;
     });
-    // Многопоточное удаление если документ содержит минус-слово
-    std::for_each(policy,
-                  query.words_minus.begin(), query.words_minus.end(),
-                  [this, &functor, &relevances](std::string_view word) {
-        const auto word_pos = words_measures_.find(std::string(word));
-        if(word_pos == words_measures_.cend()) return;
-        for (const auto [doc_id, _] : word_pos->second) {
-            relevances.Erase(doc_id);
+    for (const auto word_minus : query.words_minus) {
+        const ResolvedWord word = resolve(word_minus);
+        if (word.term != TermDictionary::NOT_FOUND) {
+            resolved.terms_minus.push_back(word.term);
+        }
+    }
+}
+
+template<typename Filter, typename Interrupt>
+void SearchServer::FindAllDocuments(const IndexSegment& segment,
+                                    const PreparedQuery& query,
+                                    const DocumentBitmap& candidates,
+                                    Filter filter,
+                                    TopDocuments& top_documents,
+                                    ScoringScratch& scratch,
+                                    Interrupt interrupt) {
+    if(top_documents.capacity() == 0) return;
+    const std::vector<QueryTerm>& terms = query.terms_plus;
+    const size_t term_count = terms.size();
+    auto& cursors = scratch.cursors;
+    cursors.clear();
+    // bounds[i] - оценка сверху суммарного вклада слов terms[0..i)
+    auto& bounds = scratch.bounds;
+    bounds.assign(term_count + 1, 0.);
+    for (size_t i = 0; i < term_count; ++i) {
+        cursors.emplace_back(*terms[i].postings);
+        bounds[i + 1] = bounds[i] + terms[i].upper_bound;
+    }
+    auto& minus_cursors = scratch.minus_cursors;
+    minus_cursors.clear();
+    for (const PostingList* postings : query.postings_minus) {
+        minus_cursors.emplace_back(*postings);
+    }
+    // слова до first_essential не могут поднять документ в выдачу сами по себе:
+    // кандидаты берутся только из списков остальных слов
+    // выдача, заполненная предыдущими сегментами, сразу задаёт порог
+    size_t first_essential = 0;
+    double threshold = -std::numeric_limits<double>::infinity();
+    const auto raise_threshold = [&]() {
+        threshold = top_documents.Worst().relevance;
+        while (first_essential < term_count &&
+               bounds[first_essential + 1] + RELEVANCE_BOUND_SLACK < threshold) {
+            ++first_essential;
+        }
+    };
+    if (top_documents.IsFull()) {
+        raise_threshold();
+    }
+    // кандидаты набираются окнами номеров документов в плотный массив
+    auto& window_relevances = scratch.window_relevances;
+    auto& window_touched = scratch.window_touched;
+    window_relevances.assign(SCORING_WINDOW_SIZE, 0.);
+    window_touched.assign(SCORING_WINDOW_SIZE, 0);
+    // отбор минус-словами и выдача идут вперемешку с расчётом релевантности,
+    // поэтому вместо замеров времени считаются документы
+    uint64_t minus_excluded = 0;
+    uint64_t top_pushed = 0;
+    while (first_essential < term_count) {
+        interrupt();
+        uint32_t window_begin = PostingList::Cursor::END;
+        for (size_t i = first_essential; i < term_count; ++i) {
+            window_begin = std::min(window_begin, cursors[i].Document());
+        }
+        if (window_begin == PostingList::Cursor::END) break;
+        const uint32_t window_end = window_begin + std::min(SCORING_WINDOW_SIZE, PostingList::Cursor::END - window_begin);
+        for (size_t i = first_essential; i < term_count; ++i) {
+            for (auto& cursor = cursors[i]; cursor.Document() < window_end; cursor.Next()) {
+                const uint32_t offset = cursor.Document() - window_begin;
+                window_touched[offset] = 1;
+                window_relevances[offset] += cursor.Frequency() * terms[i].weight;
+            }
+        }
+        // кандидаты окна обходятся по возрастанию номеров документов,
+        // как того требуют курсоры досчитываемых слов
+        for (uint32_t offset = 0; offset < window_end - window_begin; ++offset) {
+            if (!window_touched[offset]) continue;
+            const uint32_t ordinal = window_begin + offset;
+            double relevance = window_relevances[offset];
+            window_relevances[offset] = 0;
+            window_touched[offset] = 0;
+            if (!candidates.Contains(ordinal)) continue;
+            // досчитываем остальные слова, пока документ может попасть в выдачу
+            bool pruned = false;
+            for (size_t i = first_essential; i-- > 0;) {
+                if (relevance + bounds[i + 1] + RELEVANCE_BOUND_SLACK < threshold) {
+                    pruned = true;
+                    break;
+                }
+                cursors[i].Seek(ordinal);
+                if (cursors[i].Document() == ordinal) {
+                    relevance += cursors[i].Frequency() * terms[i].weight;
+                }
+            }
+            if (pruned || relevance + RELEVANCE_BOUND_SLACK < threshold) continue;
+            const IndexSegment::DocumentRecord& document = segment.Document(ordinal);
+            if (!filter(document)) continue;
+            if (IsDocHasMinus(ordinal, minus_cursors)) {
+                ++minus_excluded;
+                continue;
+            }
+            // порядок суммирования выше зависит от разбиения слов на досчитываемые,
+            // поэтому релевантность попадающего в выдачу документа пересчитывается
+            top_documents.Push({document.id, CalcRelevance(document, query.terms_by_id), document.data.rating});
+            ++top_pushed;
+            if (!top_documents.IsFull()) continue;
+            // порог вырос - переносим слабые слова в досчитываемые
+            // их вклад в документы текущего окна уже учтён, курсоры ушли за окно
+            raise_threshold();
         }
-    });
-    // Преобразуем ConcurrentMap<k,v> в std::map<k,v>
-    auto document_to_relevance = relevances.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(document_to_relevance.size());
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
     }
-    return matched_documents;
+    METRICS_ADD("query.minus_excluded", minus_excluded);
+    METRICS_ADD("query.top_k_pushed", top_pushed);
+}
+
+template<typename ExecutionPolicy, typename Filter, typename Interrupt>
+void SearchServer::FindAllDocuments(ExecutionPolicy policy,
+                                    const IndexSegment& segment,
+                                    const ResolvedQuery& query,
+                                    const DocumentBitmap& candidates,
+                                    Filter filter,
+                                    TopDocuments& top_documents,
+                                    Interrupt interrupt) {
+    if (query.terms_plus.empty() || top_documents.capacity() == 0) return;
+    // пространство номеров документов сегмента делится на диапазоны (шарды),
+    // каждый поток считает все слова запроса по своему диапазону,
+    // поэтому число потоков не зависит от длины запроса
+    const uint32_t first_ordinal = segment.FirstOrdinal();
+    const size_t document_count = segment.Span();
+    const size_t cost = QueryCost(query, segment);
+    const size_t shard_count = std::max<size_t>(1, std::min(PolicyParallelism(policy, cost),
+                                                            document_count / MIN_SHARD_SPAN));
+    const size_t shard_size = (document_count + shard_count - 1) / shard_count;
+    // выдачи диапазонов сливаются в общую по мере готовности
+    std::mutex merge_mutex;
+    PolicyForEach(policy, shard_count, cost, [&](size_t shard) {
+        const auto first = static_cast<uint32_t>(first_ordinal + std::min(document_count, shard * shard_size));
+        const auto last = static_cast<uint32_t>(first_ordinal + std::min(document_count, (shard + 1) * shard_size));
+        if (first == last) return;
+        interrupt();
+        // накопитель и выдача шарда - буферы потока, номера относительно начала диапазона
+        ShardScratch& scratch = GetShardScratch();
+        ScoreAccumulator& accumulator = scratch.accumulator;
+        accumulator.Reset(last - first);
+        for (const auto& [term, weight] : query.terms_plus) {
+            const PostingList* postings = segment.FindPostings(term);
+            if (postings == nullptr) continue;
+            postings->ForEachInRange(first, last, [&accumulator, first, weight = weight](uint32_t ordinal, double frequency) {
+                accumulator.Add(ordinal - first, frequency * weight);
+            });
+        }
+        for (const uint32_t term : query.terms_minus) {
+            const PostingList* postings = segment.FindPostings(term);
+            if (postings == nullptr) continue;
+            postings->ForEachDocumentInRange(first, last, [&accumulator, first](uint32_t ordinal) {
+                accumulator.Exclude(ordinal - first);
+            });
+        }
+        // выдача шарда набирается из затронутых документов диапазона
+        TopDocuments& shard_top = scratch.top_documents;
+        shard_top.Reset(top_documents.capacity(), top_documents.After());
+        for (const uint32_t offset : accumulator.Touched()) {
+            if (!accumulator.IsScored(offset) || accumulator.IsExcluded(offset)) continue;
+            const uint32_t ordinal = first + offset;
+            if (!candidates.Contains(ordinal)) continue;
+            const IndexSegment::DocumentRecord& document = segment.Document(ordinal);
+            if (!filter(document)) continue;
+            shard_top.Push({document.id, accumulator.Score(offset), document.data.rating});
+        }
+        std::lock_guard lock(merge_mutex);
+        for (const Document& document : shard_top) {
+            top_documents.Push(document);
+        }
+    });
 }
@@ -1,7 +1,142 @@
 #include "string_processing.h"
 #include <algorithm>
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define STRING_PROCESSING_AVX2
+#endif
 
 using namespace std;
+
+namespace {
+/**
+ * Состояние разбора текста на слова
+ */
+struct SplitState {
+    /**
+     * Смещение начала текущего слова
+     */
+    size_t word_begin = 0;
+    /**
+     * Является ли предыдущий символ частью слова
+     */
+    bool in_word = false;
+};
+/**
+ * Записать границы слов блока из width символов, начинающегося со смещения block_begin
+ * non_space - маска непробельных символов блока, младший бит - первый символ
+ */
+inline void EmitWordBounds(uint64_t non_space, size_t width, size_t block_begin, SplitState& state,
+                           vector<StringProcessing::WordSpan>& words) {
+    // биты символов, отличающихся от предыдущего: начала и концы слов по очереди
+    uint64_t changes = (non_space ^ ((non_space << 1) | (state.in_word ? 1 : 0))) & ((uint64_t{1} << width) - 1);
+    while(changes != 0) {
+        const size_t pos = block_begin + static_cast<size_t>(__builtin_ctzll(changes));
+        if(state.in_word) {
+            words.push_back({state.word_begin, pos - state.word_begin});
+        } else {
+            state.word_begin = pos;
+        }
+        state.in_word = !state.in_word;
+        changes &= changes - 1;
+    }
+}
+/**
+ * Разобрать посимвольно текст с позиции pos до конца и закрыть последнее слово
+ */
+bool SplitTail(string_view text, size_t pos, SplitState& state, vector<StringProcessing::WordSpan>& words) {
+    for(; pos < text.size(); ++pos) {
+        const char c = text[pos];
+        if(StringProcessing::IsNonValidChar(c)) {
+            return false;
+        }
+        if((c != ' ') != state.in_word) {
+            if(state.in_word) {
+                words.push_back({state.word_begin, pos - state.word_begin});
+            } else {
+                state.word_begin = pos;
+            }
+            state.in_word = !state.in_word;
+        }
+    }
+    if(state.in_word) {
+        words.push_back({state.word_begin, text.size() - state.word_begin});
+    }
+    return true;
+}
+#ifdef __SSE2__
+/**
+ * Разбор блоками по 16 символов
+ * Недопустимые символы - коды 0..31 - и пробелы ищутся одними сравнениями
+ */
+bool SplitSse2(string_view text, vector<StringProcessing::WordSpan>& words) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    SplitState state;
+    size_t pos = 0;
+    for(; pos + 16 <= text.size(); pos += 16) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+        const __m128i control = _mm_and_si128(_mm_cmpgt_epi8(chars, minus_one), _mm_cmpgt_epi8(space, chars));
+        if(_mm_movemask_epi8(control) != 0) {
+            return false;
+        }
+        const auto spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, space)));
+        EmitWordBounds(~spaces, 16, pos, state, words);
+    }
+    return SplitTail(text, pos, state, words);
+}
+#endif
+#ifdef STRING_PROCESSING_AVX2
+/**
+ * Разбор блоками по 32 символа, если процессор поддерживает AVX2
+ */
+__attribute__((target("avx2")))
+bool SplitAvx2(string_view text, vector<StringProcessing::WordSpan>& words) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+    SplitState state;
+    size_t pos = 0;
+    for(; pos + 32 <= text.size(); pos += 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + pos));
+        const __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(chars, minus_one), _mm256_cmpgt_epi8(space, chars));
+        if(!_mm256_testz_si256(control, control)) {
+            return false;
+        }
+        const auto spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, space)));
+        EmitWordBounds(~spaces, 32, pos, state, words);
+    }
+    return SplitTail(text, pos, state, words);
+}
+#endif
+#ifndef __SSE2__
+/**
+ * Посимвольный разбор
+ */
+bool SplitScalar(string_view text, vector<StringProcessing::WordSpan>& words) {
+    SplitState state;
+    return SplitTail(text, 0, state, words);
+}
+#endif
+/**
+ * Лучший разбор, доступный процессору
+ */
+using SplitFunction = bool (*)(string_view, vector<StringProcessing::WordSpan>&);
+SplitFunction SelectSplit() {
+#ifdef STRING_PROCESSING_AVX2
+    if(__builtin_cpu_supports("avx2")) {
+        return SplitAvx2;
+    }
+#endif
+#ifdef __SSE2__
+    return SplitSse2;
+#else
+    return SplitScalar;
+#endif
+}
+}
 /**
  * Описание ошибки - недопустимый код символа
  */
@@ -50,9 +185,18 @@ vector<string> StringProcessing::SplitIntoWords(const string& text) {
 }
 /**
  * Разложить входной текст в вектор из слов
+ * Недопустимые символы не проверяются: текст с ними разбирается поиском пробелов
  */
 std::vector<std::string_view> StringProcessing::SplitIntoWordsView(std::string_view text) {
     std::vector<std::string_view> words;
+    std::vector<WordSpan> spans;
+    if(SplitIntoWordSpans(text, spans)) {
+        words.reserve(spans.size());
+        for(const WordSpan& span : spans) {
+            words.push_back(text.substr(span.begin, span.length));
+        }
+        return words;
+    }
     text.remove_prefix(std::min(text.find_first_not_of(' '), text.size()));
     const std::string_view::size_type pos_end = std::string_view::npos;
     while (!text.empty()) {
@@ -62,3 +206,15 @@ std::vector<std::string_view> StringProcessing::SplitIntoWordsView(std::string_v
     }
     return words;
 }
+/**
+ * Разложить текст на слова одним проходом с проверкой символов
+ * Границы слов записываются в words, очищаемый перед разбором, -
+ * вызывающий переиспользует буфер, и разбор не выделяет память
+ * Возвращает false, если текст содержит недопустимый символ
+ * Пробелы и недопустимые символы ищутся блоками на AVX2 или SSE2
+ */
+bool StringProcessing::SplitIntoWordSpans(std::string_view text, std::vector<WordSpan>& words) {
+    static const SplitFunction split = SelectSplit();
+    words.clear();
+    return split(text, words);
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include <cstddef>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <stdexcept>
@@ -8,6 +10,19 @@
  */
 class StringProcessing {
 public:
+    /**
+     * Границы слова в тексте
+     */
+    struct WordSpan {
+        /**
+         * Смещение первого символа слова
+         */
+        size_t begin;
+        /**
+         * Длина слова
+         */
+        size_t length;
+    };
     /**
      * Является ли символ невалидным
      */
@@ -24,6 +39,13 @@ public:
      * Разложить входной текст в вектор из слов
      */
     static std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
+    /**
+     * Разложить текст на слова одним проходом с проверкой символов
+     * Границы слов записываются в words, очищаемый перед разбором, -
+     * вызывающий переиспользует буфер, и разбор не выделяет память
+     * Возвращает false, если текст содержит недопустимый символ
+     */
+    static bool SplitIntoWordSpans(std::string_view text, std::vector<WordSpan>& words);
     /**
      * Преобразовать контейнер в набор из непустых слов
      */
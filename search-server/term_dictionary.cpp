@@ -0,0 +1,119 @@
+#include "term_dictionary.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+using namespace std;
+/**
+ * Перемещение допустимо, только пока словарь никто не читает
+ */
+TermDictionary::TermDictionary(TermDictionary&& other) noexcept :
+    chunks_(move(other.chunks_)),
+    free_begin_(exchange(other.free_begin_, nullptr)),
+    free_end_(exchange(other.free_end_, nullptr)),
+    arena_size_(exchange(other.arena_size_, 0)),
+    term_blocks_(move(other.term_blocks_)),
+    size_(other.size_.exchange(0)),
+    tables_(move(other.tables_)),
+    table_(other.table_.exchange(nullptr)) { }
+/**
+ * Получить идентификатор слова, добавив слово в словарь при необходимости
+ * Запись слова заполняется до публикации идентификатора в таблице поиска,
+ * поэтому читатель, нашедший идентификатор, видит и слово
+ */
+uint32_t TermDictionary::Intern(std::string_view term) {
+    const uint32_t found = Find(term);
+    if(found != NOT_FOUND) {
+        return found;
+    }
+    const auto id = static_cast<uint32_t>(size_.load(memory_order_relaxed));
+    const size_t block = BlockOf(id);
+    if(term_blocks_[block] == nullptr) {
+        term_blocks_[block] = make_unique<string_view[]>(FIRST_TERM_BLOCK << block);
+    }
+    term_blocks_[block][id - BlockBegin(block)] = Store(term);
+    const Table* table = table_.load(memory_order_relaxed);
+    if(table == nullptr || (static_cast<size_t>(id) + 1) * 2 > table->mask + 1) {
+        Rebuild(max(MIN_TABLE_SIZE, (table == nullptr ? 0 : table->mask + 1) * 2));
+        table = table_.load(memory_order_relaxed);
+    }
+    Insert(*table, id);
+    size_.store(static_cast<size_t>(id) + 1, memory_order_release);
+    return id;
+}
+/**
+ * Идентификатор слова или NOT_FOUND
+ * Поиск идёт по string_view без создания временных строк и без блокировок
+ */
+uint32_t TermDictionary::Find(std::string_view term) const {
+    const Table* table = table_.load(memory_order_acquire);
+    if(table == nullptr) {
+        return NOT_FOUND;
+    }
+    for(size_t slot = hash<string_view>{}(term) & table->mask;; slot = (slot + 1) & table->mask) {
+        const uint32_t id = table->slots[slot].load(memory_order_acquire);
+        if(id == NOT_FOUND || Term(id) == term) {
+            return id;
+        }
+    }
+}
+/**
+ * Объём словаря в байтах
+ */
+size_t TermDictionary::MemoryUsage() const noexcept {
+    size_t usage = arena_size_;
+    for(size_t block = 0; block < TERM_BLOCK_COUNT; ++block) {
+        if(term_blocks_[block] != nullptr) {
+            usage += (FIRST_TERM_BLOCK << block) * sizeof(string_view);
+        }
+    }
+    for(const auto& table : tables_) {
+        usage += (table->mask + 1) * sizeof(uint32_t);
+    }
+    return usage;
+}
+/**
+ * Скопировать строку в арену
+ * Длинные слова получают отдельный блок
+ */
+std::string_view TermDictionary::Store(std::string_view term) {
+    if(static_cast<size_t>(free_end_ - free_begin_) < term.size()) {
+        const size_t chunk_size = max(CHUNK_SIZE, term.size());
+        chunks_.push_back(make_unique<char[]>(chunk_size));
+        free_begin_ = chunks_.back().get();
+        free_end_ = free_begin_ + chunk_size;
+        arena_size_ += chunk_size;
+    }
+    char* stored = free_begin_;
+    copy(term.begin(), term.end(), stored);
+    free_begin_ += term.size();
+    return {stored, term.size()};
+}
+/**
+ * Вставить идентификатор в таблицу поиска
+ */
+void TermDictionary::Insert(const Table& table, uint32_t id) const {
+    size_t slot = hash<string_view>{}(Term(id)) & table.mask;
+    while(table.slots[slot].load(memory_order_relaxed) != NOT_FOUND) {
+        slot = (slot + 1) & table.mask;
+    }
+    table.slots[slot].store(id, memory_order_release);
+}
+/**
+ * Опубликовать таблицу поиска на capacity слов
+ * Новая таблица заполняется до публикации, прежняя остаётся доступной читателям
+ */
+void TermDictionary::Rebuild(size_t capacity) {
+    auto table = make_unique<Table>();
+    table->mask = capacity - 1;
+    table->slots = make_unique<atomic<uint32_t>[]>(capacity);
+    for(size_t slot = 0; slot < capacity; ++slot) {
+        table->slots[slot].store(NOT_FOUND, memory_order_relaxed);
+    }
+    const auto count = static_cast<uint32_t>(size_.load(memory_order_relaxed));
+    for(uint32_t id = 0; id < count; ++id) {
+        Insert(*table, id);
+    }
+    table_.store(table.get(), memory_order_release);
+    tables_.push_back(move(table));
+}
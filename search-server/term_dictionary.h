@@ -0,0 +1,141 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+/**
+ * Словарь слов с плотными целочисленными идентификаторами.
+ * Каждое слово хранится один раз в общей области памяти (арене),
+ * строки арены не перемещаются, поэтому string_view на них
+ * остаются действительными, пока жив словарь, в том числе после его перемещения.
+ * Идентификаторы не переиспользуются: слово, исчезнувшее из документов,
+ * сохраняет свой идентификатор на случай повторного добавления.
+ * Слова добавляет один писатель, искать их можно одновременно с добавлением:
+ * записи по идентификаторам не перемещаются, а таблица поиска при росте
+ * публикуется заново
+ */
+class TermDictionary {
+public:
+    /**
+     * Идентификатор, возвращаемый для отсутствующего слова
+     */
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    TermDictionary() = default;
+    /**
+     * Перемещение допустимо, только пока словарь никто не читает
+     */
+    TermDictionary(TermDictionary&& other) noexcept;
+    TermDictionary(const TermDictionary&) = delete;
+    /**
+     * Получить идентификатор слова, добавив слово в словарь при необходимости
+     * Одновременно слова добавляет только один поток
+     */
+    uint32_t Intern(std::string_view term);
+    /**
+     * Идентификатор слова или NOT_FOUND
+     * Поиск идёт по string_view без создания временных строк и без блокировок
+     */
+    uint32_t Find(std::string_view term) const;
+    /**
+     * Слово по идентификатору
+     */
+    std::string_view Term(uint32_t id) const {
+        const size_t block = BlockOf(id);
+        return term_blocks_[block][id - BlockBegin(block)];
+    }
+    /**
+     * Количество слов
+     */
+    size_t size() const noexcept {
+        return size_.load(std::memory_order_acquire);
+    }
+    /**
+     * Объём словаря в байтах
+     */
+    size_t MemoryUsage() const noexcept;
+private:
+    /**
+     * Размер блока арены
+     */
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    /**
+     * Количество слов в первом блоке записей, каждый следующий блок вдвое больше
+     */
+    static constexpr size_t FIRST_TERM_BLOCK = 1024;
+    /**
+     * Количество блоков записей, достаточное для всех идентификаторов
+     */
+    static constexpr size_t TERM_BLOCK_COUNT = 23;
+    /**
+     * Наименьший размер таблицы поиска
+     */
+    static constexpr size_t MIN_TABLE_SIZE = 1024;
+    /**
+     * Таблица поиска с открытой адресацией: ячейка хранит идентификатор слова
+     * или NOT_FOUND, заполняется не больше чем наполовину
+     */
+    struct Table {
+        size_t mask;
+        std::unique_ptr<std::atomic<uint32_t>[]> slots;
+    };
+    /**
+     * Номер блока записей, содержащего идентификатор
+     */
+    static size_t BlockOf(uint32_t id) noexcept {
+        return 63 - __builtin_clzll(id / FIRST_TERM_BLOCK + 1);
+    }
+    /**
+     * Первый идентификатор блока записей
+     */
+    static size_t BlockBegin(size_t block) noexcept {
+        return FIRST_TERM_BLOCK * ((size_t{1} << block) - 1);
+    }
+    /**
+     * Скопировать строку в арену
+     */
+    std::string_view Store(std::string_view term);
+    /**
+     * Вставить идентификатор в таблицу поиска
+     */
+    void Insert(const Table& table, uint32_t id) const;
+    /**
+     * Опубликовать таблицу поиска на capacity слов
+     */
+    void Rebuild(size_t capacity);
+    /**
+     * Блоки арены
+     */
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    /**
+     * Свободное место в последнем блоке
+     */
+    char* free_begin_ = nullptr;
+    char* free_end_ = nullptr;
+    /**
+     * Общий размер блоков арены
+     */
+    size_t arena_size_ = 0;
+    /**
+     * Слова по идентификатору блоками растущего размера, указывают в арену
+     * Блоки не перемещаются, поэтому запись читается во время добавления слов
+     */
+    std::array<std::unique_ptr<std::string_view[]>, TERM_BLOCK_COUNT> term_blocks_;
+    /**
+     * Количество слов
+     */
+    std::atomic<size_t> size_{0};
+    /**
+     * Все построенные таблицы поиска, последняя - текущая
+     * Прежние таблицы могут читать потоки, начавшие поиск до роста словаря,
+     * поэтому они хранятся до разрушения словаря: их общий размер меньше текущей
+     */
+    std::vector<std::unique_ptr<Table>> tables_;
+    /**
+     * Текущая таблица поиска
+     */
+    std::atomic<const Table*> table_{nullptr};
+};
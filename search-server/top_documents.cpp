@@ -0,0 +1,80 @@
+#include "top_documents.h"
+#include <algorithm>
+
+using namespace std;
+/**
+ * Конструктор.
+ * Принимает максимальное число документов в выдаче
+ */
+TopDocuments::TopDocuments(size_t capacity) :
+    capacity_(capacity) {
+    heap_.reserve(min(capacity_, MAX_RESERVED));
+}
+/**
+ * Предложить документ в выдачу
+ * Документ хуже всех отобранных при заполненной выдаче отбрасывается,
+ * как и документ, не следующий за заданным
+ */
+void TopDocuments::Push(const Document& document) {
+    if(after_ && !(*after_ < document)) {
+        return;
+    }
+    if(heap_.size() < capacity_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end());
+        return;
+    }
+    if(capacity_ == 0 || !(document < heap_.front())) {
+        return;
+    }
+    // вытесняем худший из отобранных документов
+    pop_heap(heap_.begin(), heap_.end());
+    heap_.back() = document;
+    push_heap(heap_.begin(), heap_.end());
+}
+/**
+ * Забрать отобранные документы, упорядоченные от лучшего к худшему
+ */
+std::vector<Document> TopDocuments::Extract() {
+    sort_heap(heap_.begin(), heap_.end());
+    return move(heap_);
+}
+/**
+ * Забрать отобранные документы в documents, упорядоченные от лучшего к худшему
+ * Память выдачи и documents до MAX_RESERVED документов сохраняется для следующего отбора
+ */
+void TopDocuments::Extract(std::vector<Document>& documents) {
+    sort_heap(heap_.begin(), heap_.end());
+    // память прошлой глубокой выдачи не держим
+    if(documents.capacity() > max(heap_.size(), MAX_RESERVED)) {
+        vector<Document>().swap(documents);
+    }
+    documents.assign(heap_.begin(), heap_.end());
+    heap_.clear();
+}
+/**
+ * Забрать отобранные документы, упорядоченные от лучшего к худшему,
+ * записав их начиная с documents
+ * Возвращает конец записанных документов, память выдачи сохраняется
+ */
+std::vector<Document>::iterator TopDocuments::Extract(std::vector<Document>::iterator documents) {
+    sort_heap(heap_.begin(), heap_.end());
+    documents = copy(heap_.begin(), heap_.end(), documents);
+    heap_.clear();
+    return documents;
+}
+/**
+ * Начать новый отбор не больше чем capacity документов
+ * Память резервируется не больше чем под MAX_RESERVED документов
+ * Если задан документ after, отбираются только следующие за ним в порядке выдачи
+ */
+void TopDocuments::Reset(size_t capacity, const std::optional<Document>& after) {
+    capacity_ = capacity;
+    after_ = after;
+    heap_.clear();
+    // выдача больше MAX_RESERVED растёт по мере отбора, память прошлой глубокой выдачи отдаём
+    if(heap_.capacity() > MAX_RESERVED) {
+        vector<Document>().swap(heap_);
+    }
+    heap_.reserve(min(capacity_, MAX_RESERVED));
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "document.h"
+#include <optional>
+#include <vector>
+/**
+ * Отбор ограниченного числа лучших документов.
+ * Документы поступают по одному, в памяти держится не больше
+ * заданного числа лучших из них (порядок задаёт Document::operator<)
+ */
+class TopDocuments {
+public:
+    /**
+     * Наибольшее количество документов, под которое память резервируется заранее
+     * и сохраняется между отборами; больше - выдача растёт по мере отбора,
+     * а память отдаётся при следующем отборе
+     */
+    static constexpr size_t MAX_RESERVED = 1024;
+    /**
+     * Конструктор.
+     * Принимает максимальное число документов в выдаче
+     */
+    explicit TopDocuments(size_t capacity);
+    /**
+     * Предложить документ в выдачу
+     * Документ хуже всех отобранных при заполненной выдаче отбрасывается,
+     * как и документ, не следующий за заданным
+     */
+    void Push(const Document& document);
+    /**
+     * Количество отобранных документов
+     */
+    size_t size() const noexcept {
+        return heap_.size();
+    }
+    /**
+     * Заполнена ли выдача
+     */
+    bool IsFull() const noexcept {
+        return heap_.size() >= capacity_;
+    }
+    /**
+     * Худший из отобранных документов
+     * Выдача не должна быть пустой
+     */
+    const Document& Worst() const {
+        return heap_.front();
+    }
+    /**
+     * Начальный итератор отобранных документов, порядок не задан
+     */
+    std::vector<Document>::const_iterator begin() const noexcept {
+        return heap_.begin();
+    }
+    /**
+     * Конечный итератор отобранных документов
+     */
+    std::vector<Document>::const_iterator end() const noexcept {
+        return heap_.end();
+    }
+    /**
+     * Максимальное число документов в выдаче
+     */
+    size_t capacity() const noexcept {
+        return capacity_;
+    }
+    /**
+     * Документ, за которым в порядке выдачи следуют отбираемые, если он задан
+     */
+    const std::optional<Document>& After() const noexcept {
+        return after_;
+    }
+    /**
+     * Забрать отобранные документы, упорядоченные от лучшего к худшему
+     */
+    std::vector<Document> Extract();
+    /**
+     * Забрать отобранные документы в documents, упорядоченные от лучшего к худшему
+     * Память выдачи и documents до MAX_RESERVED документов сохраняется для следующего отбора
+     */
+    void Extract(std::vector<Document>& documents);
+    /**
+     * Забрать отобранные документы, упорядоченные от лучшего к худшему,
+     * записав их начиная с documents
+     * Возвращает конец записанных документов, память выдачи сохраняется
+     */
+    std::vector<Document>::iterator Extract(std::vector<Document>::iterator documents);
+    /**
+     * Начать новый отбор не больше чем capacity документов
+     * Если задан документ after, отбираются только следующие за ним в порядке выдачи
+     */
+    void Reset(size_t capacity, const std::optional<Document>& after = std::nullopt);
+private:
+    /**
+     * Максимальное число документов в выдаче
+     */
+    size_t capacity_;
+    /**
+     * Документ, за которым в порядке выдачи следуют отбираемые
+     */
+    std::optional<Document> after_;
+    /**
+     * Отобранные документы.
+     * Куча, на вершине которой худший из отобранных документов
+     */
+    std::vector<Document> heap_;
+};